@@ -0,0 +1,192 @@
+#ifndef ATTENTION_LAYER_HPP
+#define ATTENTION_LAYER_HPP
+
+#include "Layer.hpp"
+#include <Eigen/Core>
+#include <Eigen/Dense>
+#include <utility>
+#include <string>
+#include <cmath>
+
+namespace NN
+{
+
+  /*
+   * multi-head self-attention, softmax(Q K^T / sqrt(d_head)) V, evaluated in
+   * tiles with an online softmax so that the N x N score matrix is never formed.
+   * the backward pass recomputes the score tiles from Q, K and the per-row
+   * log-sum-exp saved in the forward pass, so memory is O(N) in the sequence length.
+   *
+   * rows of the input are sequence positions, columns are features. like Layer,
+   * every weight matrix carries its bias in the last row.
+   * */
+  class AttentionLayer
+  {
+
+  protected:
+
+    int_t model_dim;
+
+    int_t num_heads;
+
+    int_t head_dim;
+
+    int_t block_size;
+
+    bool causal;
+
+    double scale;
+
+    //projections, each (model_dim+1) x model_dim, last row is bias
+    Mat Wq, Wk, Wv, Wo;
+
+    Mat gradWq, gradWk, gradWv, gradWo;
+
+    OptimizerState stateWq, stateWk, stateWv, stateWo;
+
+    Mat inputs;
+
+    Mat inputMat;
+
+    Mat Q, K, V;
+
+    //concatenated head outputs, before the output projection
+    Mat attn;
+
+    Mat attnMat;
+
+    //per-row, per-head log-sum-exp of the scores, N x num_heads
+    Mat logSumExp;
+
+    Mat outputs;
+
+    Mat inputGrad;
+
+    OptimizerParams optParams;
+
+    UpdateRule update=UpdateRule::Momentum;
+
+    std::string name="AttentionLayer";
+
+    void headForward(int_t h);
+
+    void headBackward(int_t h, ConstMatRef dAttn, MatRef dQ, MatRef dK, MatRef dV) const;
+
+  public:
+
+    AttentionLayer(int_t _model_dim,
+		   int_t _num_heads,
+		   int_t _block_size=64,
+		   bool _causal=false) :
+      model_dim(_model_dim),
+      num_heads(_num_heads),
+      block_size(_block_size),
+      causal(_causal)
+    {
+      if(model_dim <= 0 or num_heads <= 0 or model_dim % num_heads != 0){
+	throw "Error: model_dim must be a positive multiple of num_heads.";
+      }
+      if(block_size <= 0){
+	throw "Error: block_size must be positive.";
+      }
+      head_dim = model_dim / num_heads;
+      scale = 1.0 / std::sqrt(static_cast<double>(head_dim));
+
+      //scale initial weights so the scores start out O(1)
+      double ws = 1.0 / std::sqrt(static_cast<double>(model_dim));
+      Wq = ws * Mat::Random(model_dim + 1, model_dim);
+      Wk = ws * Mat::Random(model_dim + 1, model_dim);
+      Wv = ws * Mat::Random(model_dim + 1, model_dim);
+      Wo = ws * Mat::Random(model_dim + 1, model_dim);
+    };
+
+    auto getOutputs() const noexcept
+    {
+      return outputs;
+    }
+
+    auto getModelDim() const noexcept
+    {
+      return model_dim;
+    }
+
+    auto getNumHeads() const noexcept
+    {
+      return num_heads;
+    }
+
+    auto getBlockSize() const noexcept
+    {
+      return block_size;
+    }
+
+    void setBlockSize(int_t _block_size)
+    {
+      if(_block_size <= 0){
+	throw "Error: block_size must be positive.";
+      }
+      block_size = _block_size;
+    }
+
+    auto getName()
+    {
+      return name;
+    }
+
+    void setName(std::string newName)
+    {
+      name = newName;
+    }
+
+    //returns the (query, key, value, output) projection weights
+    std::tuple<Mat,Mat,Mat,Mat> getWeights() const
+    {
+      return std::make_tuple(Wq, Wk, Wv, Wo);
+    }
+
+    void setWeights(const Mat& _Wq, const Mat& _Wk, const Mat& _Wv, const Mat& _Wo);
+
+    std::tuple<Mat,Mat,Mat,Mat> getGradient() const
+    {
+      return std::make_tuple(gradWq, gradWk, gradWv, gradWo);
+    }
+
+    //derivative of the loss w.r.t. this layer's inputs, for chaining to earlier layers
+    Mat getInputGrad() const
+    {
+      return inputGrad;
+    }
+
+    void setUpdateParams(double learningrate, double momentum) noexcept
+    {
+      optParams.learningRate = learningrate;
+      optParams.momentum = momentum;
+    }
+
+    std::tuple<double,double> getUpdateParams() const noexcept
+    {
+      return std::make_tuple(optParams.learningRate, optParams.momentum);
+    }
+
+    void setOptimizer(UpdateRule rule, const OptimizerParams& params) noexcept
+    {
+      if(rule != update){
+	stateWq.reset();
+	stateWk.reset();
+	stateWv.reset();
+	stateWo.reset();
+      }
+      update = rule;
+      optParams = params;
+    }
+
+    void forwardPass(ConstMatRef inputData);
+
+    void backwardPass(ConstMatRef loss_grad);
+
+    void updateWeights();
+
+  };//end class AttentionLayer
+
+}//end namespace NN
+#endif //ATTENTION_LAYER_HPP
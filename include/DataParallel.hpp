@@ -0,0 +1,104 @@
+#ifndef DATA_PARALLEL_HPP
+#define DATA_PARALLEL_HPP
+
+#include "Network.hpp"
+#include <Eigen/Core>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+
+namespace NN
+{
+
+  /*
+   * synchronous data-parallel steps on a pool of numThreads threads (the caller's thread is
+   * worker 0). each batch is cut into numThreads contiguous slices; worker t runs forward
+   * and backward on slice t with its own replica of the network, so activations and
+   * gradients are thread-local while the weights are the network's. the per-layer gradients
+   * are then summed by a pairwise tree (worker t adds worker t + s at stride s = 1, 2, 4...,
+   * each worker touching only its own and one neighbour's buffers), and the network runs a
+   * single updateWeights(). slicing and reduction order depend only on numThreads, so
+   * results are bit-reproducible for a fixed thread count.
+   * */
+  class DataParallelTrainer
+  {
+
+  protected:
+
+    class Barrier
+    {
+      std::mutex mtx;
+      std::condition_variable cv;
+      int count, waiting = 0;
+      size_t generation = 0;
+
+    public:
+
+      explicit Barrier(int _count) :
+	count(_count)
+      {};
+
+      void wait();
+    };
+
+    int numThreads;
+
+    Barrier barrier;
+
+    std::vector<std::thread> pool;
+
+    bool stopping = false;
+
+    std::vector<Network> replicas;
+
+    //the network the replicas were copied from, rebuilt when another one (or a reshaped
+    //one) comes along
+    const Network* replicaSource = nullptr;
+
+    //grads[t][l]: layer l's gradient summed over worker t's slice (and, after the
+    //reduction, over the slices merged into it)
+    std::vector<std::vector<Mat>> grads;
+
+    std::vector<double> losses;
+
+    //an exception thrown in a worker's slice, rethrown by step() once every worker is done
+    std::vector<std::exception_ptr> errors;
+
+    //the current step's batch and weights
+    const Mat* stepInputs = nullptr;
+
+    const Vec* stepTarget = nullptr;
+
+    Vec stepWeights;
+
+    void poolLoop(int id);
+
+    void work(int id);
+
+    bool replicasMatch(Network& net);
+
+  public:
+
+    explicit DataParallelTrainer(int _numThreads);
+
+    ~DataParallelTrainer();
+
+    DataParallelTrainer(const DataParallelTrainer&) = delete;
+
+    DataParallelTrainer& operator=(const DataParallelTrainer&) = delete;
+
+    auto getNumThreads() const noexcept
+    {
+      return numThreads;
+    }
+
+    //one synchronous update of net on the batch; returns the loss over the whole batch.
+    //an exception in any worker is rethrown here, with net left unchanged
+    double step(Network& net, const Mat& batchInputs, const Vec& batchTarget);
+
+  };
+
+}//end namespace NN
+#endif //DATA_PARALLEL_HPP
@@ -0,0 +1,156 @@
+#ifndef DISTRIBUTED_LAYER_HPP
+#define DISTRIBUTED_LAYER_HPP
+
+//only available when the library is built with PETSc (make PETSC_DIR=... PETSC_ARCH=...)
+#ifdef NN_HAVE_PETSC
+
+#include "Layer.hpp"
+#include "Optimizer.hpp"
+#include <Eigen/Core>
+#include <petscmat.h>
+#include <string>
+
+namespace NN
+{
+
+  /*
+   * a dense layer too large for one rank. the (inputs+1) x outputs weights, bias in the last
+   * row as in Layer, are a PETSc MATMPIDENSE whose rows are split across the ranks of comm,
+   * and so are its gradient and optimizer state, so the layer's memory scales down with the
+   * number of ranks.
+   *
+   * every rank passes its own rows of the batch (all input columns) and gets back its rows
+   * of the outputs, like a data-parallel replica, so single-node layers chain on either side
+   * through getOutputs() and getInputGrad() exactly as with EmbeddingLayer. the batch is
+   * held as distributed activation matrices: [inputs, 1] with the columns laid out like the
+   * weights' rows, and the output errors. forward is MatMatMult([inputs, 1], W), the weight
+   * gradient MatTransposeMatMult([inputs, 1], err) (summed over every rank's rows), and the
+   * input gradient MatMatTransposeMult(err, W). the update runs the fused optimizer kernel
+   * on each rank's rows; the layer-wise rules (LARS, LAMB) and the regularizers are not
+   * supported.
+   *
+   * all methods except the getters of local data are collective over comm.
+   * */
+  class DistributedLayer
+  {
+
+  protected:
+
+    MPI_Comm comm;
+
+    int_t input_size, output_size;
+
+    //this rank's rows of the weights: [firstRow, firstRow + localRows)
+    PetscInt firstRow = 0, localRows = 0;
+
+    ::Mat weights = nullptr;
+
+    ::Mat gradient = nullptr;
+
+    //[inputs, 1] and err for this rank's batch rows, and the products made from them
+    ::Mat inputMat = nullptr, errMat = nullptr, actMat = nullptr, inputGradMat = nullptr;
+
+    PetscInt localBatch = -1;
+
+    //this rank's rows of the pre-activations, outputs, err and input gradient
+    Mat actVals, outputs, err, inputGrad;
+
+    std::string activationName;
+
+    std::function<double(double)> activation;
+
+    std::function<Mat(std::pair<ConstMatRef,ConstMatRef>)> activation_grad;
+
+    UpdateRule update = UpdateRule::Momentum;
+
+    OptimizerParams optParams;
+
+    OptimizerState optState;
+
+    std::string name = "DistributedLayer";
+
+    void destroyActivations();
+
+  public:
+
+    //weights uniform in [-1, 1], seeded per global row so they do not depend on the ranks
+    DistributedLayer(MPI_Comm _comm, int_t _input_size, int_t _output_size,
+		     std::string _activation="relu", unsigned seed=0);
+
+    ~DistributedLayer();
+
+    DistributedLayer(const DistributedLayer&) = delete;
+
+    DistributedLayer& operator=(const DistributedLayer&) = delete;
+
+    auto getInputSize() const noexcept
+    {
+      return input_size;
+    }
+
+    auto getOutputSize() const noexcept
+    {
+      return output_size;
+    }
+
+    auto getOwnershipRange() const noexcept
+    {
+      return std::make_pair(static_cast<int_t>(firstRow), static_cast<int_t>(firstRow + localRows));
+    }
+
+    //weights this rank stores
+    int_t numLocalParams() const noexcept
+    {
+      return localRows * output_size;
+    }
+
+    const Mat& getOutputs() const noexcept
+    {
+      return outputs;
+    }
+
+    //derivative of the loss w.r.t. this rank's input rows, from the last backwardPass()
+    const Mat& getInputGrad() const noexcept
+    {
+      return inputGrad;
+    }
+
+    ::Mat getPetscWeights() const noexcept
+    {
+      return weights;
+    }
+
+    //the whole weight matrix on every rank
+    Mat getWeights() const;
+
+    //every rank passes the whole matrix and keeps its rows
+    void setWeights(ConstMatRef _weights);
+
+    void setActivation(std::string actName);
+
+    void setOptimizer(UpdateRule rule, const OptimizerParams& params);
+
+    auto getName()
+    {
+      return name;
+    }
+
+    void setName(std::string newName)
+    {
+      name = newName;
+    }
+
+    //inputs are this rank's batch rows, input_size columns; any rank may have zero rows
+    void forwardPass(ConstMatRef inputs);
+
+    //loss_grad: derivative of the loss w.r.t. this rank's output rows
+    void backwardPass(ConstMatRef loss_grad);
+
+    void updateWeights();
+
+  };
+
+}//end namespace NN
+
+#endif //NN_HAVE_PETSC
+#endif //DISTRIBUTED_LAYER_HPP
@@ -0,0 +1,147 @@
+#ifndef EMBEDDING_LAYER_HPP
+#define EMBEDDING_LAYER_HPP
+
+#include "Layer.hpp"
+#include <Eigen/Core>
+#include <vector>
+#include <utility>
+#include <string>
+
+namespace NN
+{
+  using IdMat = Eigen::Matrix<int_t, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
+
+  //gradient touching only some rows of a weight matrix: values.row(k) belongs to row rows[k]
+  struct SparseRowGrad
+  {
+    std::vector<int_t> rows;
+
+    Mat values;
+  };
+
+  /*
+   * lookup table mapping integer ids to rows of a (vocab_size x embedding_dim) weight
+   * matrix. each input row holds one id per categorical field; the output row is the
+   * concatenation of the looked-up embeddings, so it can be fed straight into a Layer.
+   *
+   * the backward pass produces a SparseRowGrad over the distinct ids in the batch, and
+   * updateWeights() only touches those rows. momentum for rows that were not touched is
+   * applied lazily the next time the row is used, which gives the same weights as a
+   * dense momentum update at a cost proportional to the batch size.
+   * */
+  class EmbeddingLayer
+  {
+
+  protected:
+
+    int_t vocab_size;
+
+    int_t embedding_dim;
+
+    int_t num_fields = 0;
+
+    Mat weights;
+
+    Mat weightUpdate;
+
+    //step at which each row's weights and momentum were last brought up to date
+    std::vector<int_t> lastStep;
+
+    int_t step = 0;
+
+    IdMat ids;
+
+    Mat outputs;
+
+    SparseRowGrad gradient;
+
+    //scratch map from id to its slot in gradient.rows, -1 when unused
+    std::vector<int_t> rowSlot;
+
+    std::tuple<double,double> updateParams;
+
+    std::string name="EmbeddingLayer";
+
+    void catchUpRow(int_t row);
+
+  public:
+
+    EmbeddingLayer(int_t _vocab_size, int_t _embedding_dim) :
+      vocab_size(_vocab_size),
+      embedding_dim(_embedding_dim)
+    {
+      if(vocab_size <= 0 or embedding_dim <= 0){
+	throw "Error: vocab_size and embedding_dim must be positive.";
+      }
+      weights = Mat::Random(vocab_size, embedding_dim);
+      weightUpdate = Mat::Zero(vocab_size, embedding_dim);
+      lastStep.assign(vocab_size, 0);
+      rowSlot.assign(vocab_size, -1);
+    };
+
+    auto getVocabSize() const noexcept
+    {
+      return vocab_size;
+    }
+
+    auto getEmbeddingDim() const noexcept
+    {
+      return embedding_dim;
+    }
+
+    auto getOutputs() const noexcept
+    {
+      return outputs;
+    }
+
+    //weights with any pending momentum applied to every row
+    Mat getWeights()
+    {
+      synchronizeWeights();
+      return weights;
+    }
+
+    void setWeights(const Mat& _weights);
+
+    const SparseRowGrad& getGradient() const noexcept
+    {
+      return gradient;
+    }
+
+    auto getName()
+    {
+      return name;
+    }
+
+    void setName(std::string newName)
+    {
+      name = newName;
+    }
+
+    //pending momentum was accumulated under the old parameters, so it is applied first
+    void setUpdateParams(double learningrate, double momentum) noexcept
+    {
+      synchronizeWeights();
+      updateParams = std::tuple<double,double>(learningrate, momentum);
+    }
+
+    std::tuple<double,double> getUpdateParams() const noexcept
+    {
+      return updateParams;
+    }
+
+    //ids is (batch size x number of fields); outputs are (batch size x fields*embedding_dim)
+    void forwardPass(const IdMat& inputIds);
+
+    //loss_grad is the derivative of the loss w.r.t. the outputs, e.g. next.getInputGrad()
+    void backwardPass(ConstMatRef loss_grad);
+
+    void updateWeights();
+
+    //applies pending lazy momentum to all rows, O(vocab_size)
+    void synchronizeWeights();
+
+  };//end class EmbeddingLayer
+
+}//end namespace NN
+#endif //EMBEDDING_LAYER_HPP
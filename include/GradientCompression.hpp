@@ -0,0 +1,137 @@
+#ifndef GRADIENT_COMPRESSION_HPP
+#define GRADIENT_COMPRESSION_HPP
+
+#include "Network.hpp"
+#include <Eigen/Core>
+#include <Eigen/Dense>
+#include <vector>
+
+namespace NN
+{
+
+  enum class Compression
+    {
+     None,//8 bytes per entry
+     TopK,//the topKRatio largest entries by magnitude: 4-byte index and float value each
+     Int8,//one byte per entry plus a float scale
+     Sign,//one bit per entry (the sign) plus a float scale, the mean magnitude
+     PowerSGD//rank-r factors P (rows x r) and Q (cols x r), summed over the workers
+    };
+
+  struct CompressionOptions
+  {
+    Compression method = Compression::None;
+
+    double topKRatio = 0.01;
+
+    //PowerSGD rank; layers too small to gain from it are sent uncompressed
+    int_t rank = 2;
+
+    //add what compression dropped to the next step's gradient
+    bool errorFeedback = true;
+
+    //seeds PowerSGD's initial Q; must be the same on every worker
+    unsigned seed = 0;
+  };
+
+
+  /*
+   * lossy compression of one worker's layer gradients for data-parallel training. with
+   * error feedback each layer keeps a residual: the gradient compressed at a step is the
+   * new gradient plus the residual, and the residual becomes what the compressed version
+   * dropped, so nothing is lost, only delayed.
+   *
+   * TopK, Int8, Sign (and layers PowerSGD leaves uncompressed) produce a payload of a size
+   * fixed by the layer's shape, so the workers' payloads can be allgathered and every worker
+   * sums decodeAdd() over them in the same order. PowerSGD is linear in the gradient and
+   * instead runs as two sums over the workers:
+   *
+   *   lowRankP(M -> P = M Q), sum P; lowRankQ(orthonormalize P, Q = M^T P), sum Q;
+   *   lowRankFinish(sum = P Q^T)
+   *
+   * with Q kept as the warm start of the next step. bytes counters cover what this worker
+   * sends against the dense gradients it replaces.
+   *
+   * a residual released after many steps acts like a late, large gradient; with heavy
+   * momentum, TopK may need a smaller learning rate than uncompressed training.
+   * */
+  class GradientCompressor
+  {
+
+  protected:
+
+    CompressionOptions opts;
+
+    //per layer: the gradient plus what earlier steps dropped
+    std::vector<Mat> residual;
+
+    //per layer: PowerSGD's Q, the warm start of the next step
+    std::vector<Mat> powerQ;
+
+    size_t bytesSent = 0, bytesDense = 0;
+
+    //adds grad into layer's residual (reset first without error feedback) and returns it
+    Mat& accumulate(size_t layer, ConstMatRef grad);
+
+    int_t topK(int_t n) const noexcept;
+
+  public:
+
+    GradientCompressor(const CompressionOptions& _opts=CompressionOptions()) :
+      opts(_opts)
+    {};
+
+    const auto& getOptions() const noexcept
+    {
+      return opts;
+    }
+
+    auto getBytesSent() const noexcept
+    {
+      return bytesSent;
+    }
+
+    auto getBytesDense() const noexcept
+    {
+      return bytesDense;
+    }
+
+    //dense bytes per byte sent so far
+    double compressionRatio() const noexcept
+    {
+      return bytesSent > 0 ? static_cast<double>(bytesDense) / bytesSent : 1.0;
+    }
+
+    void resetCounters() noexcept
+    {
+      bytesSent = bytesDense = 0;
+    }
+
+    //whether a rows x cols gradient goes through lowRankP/Q/Finish rather than encode()
+    bool lowRank(int_t rows, int_t cols) const noexcept
+    {
+      return opts.method == Compression::PowerSGD and opts.rank * (rows + cols) < rows * cols;
+    }
+
+    //bytes of encode()'s payload for a rows x cols gradient
+    size_t payloadBytes(int_t rows, int_t cols) const noexcept;
+
+    //compresses layer's gradient (plus residual) into payload and updates the residual
+    void encode(size_t layer, ConstMatRef grad, unsigned char* payload);
+
+    //adds a payload's gradient (any worker's) to sum, which has the gradient's shape
+    void decodeAdd(const unsigned char* payload, MatRef sum) const;
+
+    //P = (grad + residual) Q; P must be rows x rank
+    void lowRankP(size_t layer, ConstMatRef grad, MatRef P);
+
+    //orthonormalizes the summed P in place and sets Q = (grad + residual)^T P
+    void lowRankQ(size_t layer, MatRef P, MatRef Q) const;
+
+    //sum = P Q^T from the summed Q; the residual keeps this worker's 1/numWorkers share
+    void lowRankFinish(size_t layer, ConstMatRef P, ConstMatRef Q, int numWorkers, MatRef sum);
+
+  };
+
+}//end namespace NN
+#endif //GRADIENT_COMPRESSION_HPP
@@ -0,0 +1,94 @@
+#ifndef HESSIAN_FREE_HPP
+#define HESSIAN_FREE_HPP
+
+#include "Network.hpp"
+#include <Eigen/Core>
+#include <vector>
+#include <optional>
+
+namespace NN
+{
+
+  struct NewtonCGOptions
+  {
+    size_t maxIter = 200;
+
+    //stop when |gradient| falls below this
+    double gradTol = 1.0e-6;
+
+    //curvature products from the Gauss-Newton matrix (PSD) instead of the exact Hessian
+    bool gaussNewton = true;
+
+    //inner CG stops at |residual| <= min(0.5, sqrt|g|) |g| or after cgMaxIter products
+    int_t cgMaxIter = 250;
+
+    //Tikhonov damping lambda in (H + lambda I), adapted from the reduction ratio
+    double initialDamping = 1.0;
+
+    double minDamping = 1.0e-10;
+
+    //the inner solve starts from this multiple of the previous step
+    double warmStartDecay = 0.95;
+
+    //Armijo backtracking on the Newton step
+    double c1 = 1.0e-4;
+
+    int_t maxBacktrack = 30;
+  };
+
+
+  /*
+   * truncated (Hessian-free) Newton-CG. each outer iteration solves
+   *   (H + lambda I) d = -g
+   * by CG using only Network::hessianVectorProduct(), so memory stays at a few flat weight
+   * vectors. CG stops early on the forcing term, and on negative curvature when the exact
+   * Hessian is used. the step is backtracked to satisfy Armijo, and lambda follows the
+   * Levenberg-Marquardt rule on the ratio of actual to predicted reduction.
+   * */
+  class NewtonCGTrainer
+  {
+
+  protected:
+
+    NewtonCGOptions opts;
+
+    double lambda = 0.0;
+
+    std::vector<double> lossHistory;
+
+    int_t numHessianProducts = 0;
+
+    //approximately solves (H + lambda I) d = -g starting from d; returns d^T H d
+    double truncatedCG(Network& net, const Vec& g, Vec& d);
+
+  public:
+
+    NewtonCGTrainer(const NewtonCGOptions& _opts=NewtonCGOptions()) :
+      opts(_opts)
+    {};
+
+    auto getLossHistory() const
+    {
+      return lossHistory;
+    }
+
+    auto getNumHessianProducts() const noexcept
+    {
+      return numHessianProducts;
+    }
+
+    auto getDamping() const noexcept
+    {
+      return lambda;
+    }
+
+    //returns true if the gradient tolerance was reached
+    bool train(Network& net,
+	       std::optional<Mat> inputData=std::nullopt,
+	       std::optional<Vec> target=std::nullopt,
+	       bool noprint=false);
+
+  };
+
+}//end namespace NN
+#endif //HESSIAN_FREE_HPP
@@ -0,0 +1,86 @@
+#ifndef HOGWILD_HPP
+#define HOGWILD_HPP
+
+#include "Network.hpp"
+#include <Eigen/Core>
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <vector>
+
+namespace NN
+{
+
+  struct HogwildOptions
+  {
+    int numThreads = 4;
+
+    int_t batchSize = 32;
+
+    size_t epochs = 10;
+
+    double learningRate = 1.0e-3;
+
+    unsigned seed = 0;
+  };
+
+
+  /*
+   * Hogwild: lock-free asynchronous SGD. the weights live in one shared flat array; every
+   * worker thread owns a replica of the network (its own activations and gradients), trains
+   * on its own shuffled share of the rows, and per mini-batch reads the shared weights into
+   * its replica, runs forward/backward, and subtracts learningRate * gradient from the shared
+   * array without locks. the first layer's rows for features that are zero over the whole
+   * batch (the common case for sparse features) get no gradient and don't affect the outputs,
+   * so they are neither read nor written: with sparse data workers rarely touch the same
+   * weights. the deeper layers are read and written whole, and the forward/backward pass
+   * itself is the dense one of Layer. the shared entries are relaxed atomics: racing updates
+   * may be lost, as Hogwild allows, but never torn.
+   * */
+  class HogwildTrainer
+  {
+
+  protected:
+
+    HogwildOptions opts;
+
+    std::unique_ptr<std::atomic<double>[]> shared;
+
+    //per-sample loss per epoch, averaged over the workers
+    std::vector<double> epochLoss;
+
+    //number of shared entries written, summed over all updates
+    std::atomic<int_fast64_t> numWrites{0};
+
+    //an exception thrown in a worker, rethrown by train() after the join; the others stop
+    //at their next mini-batch
+    std::vector<std::exception_ptr> errors;
+
+    std::atomic<bool> aborted{false};
+
+    void worker(int id, Network replica, ConstMatRef X, Eigen::Ref<const Vec> y,
+		std::vector<double>& loss);
+
+  public:
+
+    HogwildTrainer(const HogwildOptions& _opts=HogwildOptions()) :
+      opts(_opts)
+    {};
+
+    auto getEpochLoss() const
+    {
+      return epochLoss;
+    }
+
+    auto getNumWrites() const noexcept
+    {
+      return numWrites.load();
+    }
+
+    //trains net in place on the rows of X; the network's own update rule is not used
+    void train(Network& net, ConstMatRef X, Eigen::Ref<const Vec> y, bool noprint=false);
+
+  };
+
+}//end namespace NN
+#endif //HOGWILD_HPP
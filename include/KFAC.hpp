@@ -0,0 +1,131 @@
+#ifndef KFAC_HPP
+#define KFAC_HPP
+
+#include "Network.hpp"
+#include <Eigen/Core>
+#include <vector>
+#include <future>
+#include <optional>
+
+namespace NN
+{
+
+  struct KFACOptions
+  {
+    //running-average decay of the Kronecker factors
+    double decay = 0.95;
+
+    //Tikhonov damping of the Fisher blocks, split between the two factors
+    double damping = 1.0e-3;
+
+    //bound on lr^2 gradient^T F^-1 gradient per step (KL clipping); 0 disables
+    double klClip = 1.0e-3;
+
+    //steps between factor inversions
+    int_t inversionPeriod = 10;
+
+    //invert on a background thread and keep using the previous inverses meanwhile
+    bool async = true;
+
+    //S from the loss's err (empirical Fisher) instead of a backward pass seeded with ones,
+    //which for the L2 loss gives the Gauss-Newton/Fisher factor at the cost of a second pass
+    bool empiricalFisher = false;
+  };
+
+
+  /*
+   * K-FAC natural-gradient preconditioner for networks of dense Layers. each layer's
+   * Fisher block is approximated by A (x) S, with A = inputMat^T inputMat / batch size and
+   * S = err^T err kept as running averages, so the preconditioned gradient is
+   *   (A + pi sqrt(damping) I)^-1 gradient (S + sqrt(damping)/pi I)^-1.
+   * the inverses are refreshed every inversionPeriod steps, on a std::async thread when
+   * async is set. the preconditioned gradient replaces the layer's gradient, so any
+   * UpdateRule (plain momentum is the usual choice) applies the step.
+   * */
+  class KFACOptimizer
+  {
+
+  protected:
+
+    struct Factors
+    {
+      Mat A, S, Ainv, Sinv;
+    };
+
+    using FactorList = std::vector<std::pair<Mat, Mat>>;
+
+    KFACOptions opts;
+
+    std::vector<Factors> factors;
+
+    std::future<FactorList> pending;
+
+    int_fast64_t numSteps = 0;
+
+    //step at which the last inversion started
+    int_fast64_t lastLaunch = 0;
+
+    int_t numInversions = 0;
+
+    double gradNorm = 0.0;
+
+    std::vector<double> lossHistory;
+
+    //damped inverses of each (A, S) pair
+    static FactorList invertFactors(FactorList AS, double damping);
+
+    void collectInverses(bool wait);
+
+  public:
+
+    KFACOptimizer(const KFACOptions& _opts=KFACOptions()) :
+      opts(_opts)
+    {};
+
+    ~KFACOptimizer()
+    {
+      if(pending.valid()){
+	pending.wait();
+      }
+    }
+
+    auto getLossHistory() const
+    {
+      return lossHistory;
+    }
+
+    auto getNumInversions() const noexcept
+    {
+      return numInversions;
+    }
+
+    //norm of the unpreconditioned flat gradient from the last precondition()
+    auto getGradNorm() const noexcept
+    {
+      return gradNorm;
+    }
+
+    /*
+     * after net.predict(): runs the backward pass, updates the factors, and replaces each
+     * layer's gradient by its preconditioned version.
+     * */
+    void precondition(Network& net);
+
+    void step(Network& net)
+    {
+      precondition(net);
+      net.updateWeights();
+    }
+
+    //like Network::train, stopping when the unpreconditioned gradient norm is below stopTol
+    bool train(Network& net,
+	       double stopTol,
+	       size_t maxIter,
+	       std::optional<Mat> inputData=std::nullopt,
+	       std::optional<Vec> target=std::nullopt,
+	       bool noprint=false);
+
+  };
+
+}//end namespace NN
+#endif //KFAC_HPP
@@ -0,0 +1,285 @@
+#ifndef KERNEL_FEATURE_LAYER_HPP
+#define KERNEL_FEATURE_LAYER_HPP
+
+#include "Layer.hpp"
+#include <Eigen/Core>
+#include <Eigen/Dense>
+#include <utility>
+#include <string>
+#include <random>
+#include <cmath>
+
+namespace NN
+{
+
+  /*
+   * random Fourier features for a Gaussian kernel of the given lengthscale,
+   *   z(x) = sqrt(2/D) cos(x W + b),  W ~ N(0, 1/lengthscale^2), b ~ U(0, 2 pi),
+   * evaluated as one GEMM per batch. rows of the input are samples. the frequencies and
+   * phases are fixed unless trainable is set, and the outputs feed straight into a Layer.
+   * */
+  class RandomFourierLayer
+  {
+
+  protected:
+
+    int_t input_dim;
+
+    int_t num_features;
+
+    bool trainable;
+
+    //input_dim x num_features
+    Mat freqs;
+
+    //1 x num_features
+    Mat phases;
+
+    Mat gradFreqs, gradPhases;
+
+    OptimizerState stateFreqs, statePhases;
+
+    Mat inputs;
+
+    //x W + b, kept for the backward pass
+    Mat actVals;
+
+    Mat outputs;
+
+    Mat inputGrad;
+
+    OptimizerParams optParams;
+
+    UpdateRule update=UpdateRule::Momentum;
+
+    std::string name="RandomFourierLayer";
+
+  public:
+
+    RandomFourierLayer(int_t _input_dim,
+		       int_t _num_features,
+		       double lengthscale=1.0,
+		       bool _trainable=false,
+		       unsigned seed=std::random_device{}());
+
+    auto getOutputs() const noexcept
+    {
+      return outputs;
+    }
+
+    auto getOutputSize() const noexcept
+    {
+      return num_features;
+    }
+
+    auto getFreqs() const noexcept
+    {
+      return freqs;
+    }
+
+    auto getPhases() const noexcept
+    {
+      return phases;
+    }
+
+    void setFreqs(const Mat& _freqs, const Mat& _phases);
+
+    bool isTrainable() const noexcept
+    {
+      return trainable;
+    }
+
+    void setTrainable(bool _trainable) noexcept
+    {
+      trainable = _trainable;
+    }
+
+    //(frequency, phase) gradients, only formed when the layer is trainable
+    std::pair<Mat,Mat> getGradient() const
+    {
+      return std::make_pair(gradFreqs, gradPhases);
+    }
+
+    Mat getInputGrad() const
+    {
+      return inputGrad;
+    }
+
+    auto getName()
+    {
+      return name;
+    }
+
+    void setName(std::string newName)
+    {
+      name = newName;
+    }
+
+    void setUpdateParams(double learningrate, double momentum) noexcept
+    {
+      optParams.learningRate = learningrate;
+      optParams.momentum = momentum;
+    }
+
+    //switching rules discards the old optimizer state
+    void setOptimizer(UpdateRule rule, const OptimizerParams& params) noexcept
+    {
+      if(rule != update){
+	stateFreqs.reset();
+	statePhases.reset();
+      }
+      update = rule;
+      optParams = params;
+    }
+
+    void forwardPass(ConstMatRef inputData);
+
+    void backwardPass(ConstMatRef loss_grad);
+
+    void updateWeights();
+
+  };//end class RandomFourierLayer
+
+
+  /*
+   * Gaussian radial basis functions phi_j(x) = exp(-||x - c_j||^2 / (2 s_j^2)).
+   * squared distances for the whole batch are formed as ||x||^2 - 2 x.c + ||c||^2,
+   * so the only O(batch * centres * input_dim) work is a single GEMM. centres and
+   * widths are fixed unless trainable is set.
+   * */
+  class RBFLayer
+  {
+
+  protected:
+
+    int_t input_dim;
+
+    int_t num_centres;
+
+    bool trainable;
+
+    //num_centres x input_dim
+    Mat centres;
+
+    //1 x num_centres
+    Mat widths;
+
+    Mat gradCentres, gradWidths;
+
+    OptimizerState stateCentres, stateWidths;
+
+    Mat inputs;
+
+    //squared distances, batch x num_centres
+    Mat dist2;
+
+    Mat outputs;
+
+    Mat inputGrad;
+
+    OptimizerParams optParams;
+
+    UpdateRule update=UpdateRule::Momentum;
+
+    std::string name="RBFLayer";
+
+  public:
+
+    RBFLayer(int_t _input_dim,
+	     int_t _num_centres,
+	     double width=1.0,
+	     bool _trainable=false) :
+      input_dim(_input_dim),
+      num_centres(_num_centres),
+      trainable(_trainable)
+    {
+      if(input_dim <= 0 or num_centres <= 0 or width <= 0.0){
+	throw "Error: RBFLayer sizes and width must be positive.";
+      }
+      centres = Mat::Random(num_centres, input_dim);
+      widths = Mat::Constant(1, num_centres, width);
+    };
+
+    auto getOutputs() const noexcept
+    {
+      return outputs;
+    }
+
+    auto getOutputSize() const noexcept
+    {
+      return num_centres;
+    }
+
+    auto getCentres() const noexcept
+    {
+      return centres;
+    }
+
+    auto getWidths() const noexcept
+    {
+      return widths;
+    }
+
+    //e.g. a subset of the training inputs
+    void setCentres(const Mat& _centres);
+
+    void setWidths(const Mat& _widths);
+
+    bool isTrainable() const noexcept
+    {
+      return trainable;
+    }
+
+    void setTrainable(bool _trainable) noexcept
+    {
+      trainable = _trainable;
+    }
+
+    //(centre, width) gradients, only formed when the layer is trainable
+    std::pair<Mat,Mat> getGradient() const
+    {
+      return std::make_pair(gradCentres, gradWidths);
+    }
+
+    Mat getInputGrad() const
+    {
+      return inputGrad;
+    }
+
+    auto getName()
+    {
+      return name;
+    }
+
+    void setName(std::string newName)
+    {
+      name = newName;
+    }
+
+    void setUpdateParams(double learningrate, double momentum) noexcept
+    {
+      optParams.learningRate = learningrate;
+      optParams.momentum = momentum;
+    }
+
+    //switching rules discards the old optimizer state
+    void setOptimizer(UpdateRule rule, const OptimizerParams& params) noexcept
+    {
+      if(rule != update){
+	stateCentres.reset();
+	stateWidths.reset();
+      }
+      update = rule;
+      optParams = params;
+    }
+
+    void forwardPass(ConstMatRef inputData);
+
+    void backwardPass(ConstMatRef loss_grad);
+
+    void updateWeights();
+
+  };//end class RBFLayer
+
+}//end namespace NN
+#endif //KERNEL_FEATURE_LAYER_HPP
@@ -0,0 +1,85 @@
+#ifndef LBFGS_HPP
+#define LBFGS_HPP
+
+#include "Network.hpp"
+#include <Eigen/Core>
+#include <deque>
+#include <vector>
+#include <optional>
+
+namespace NN
+{
+
+  struct LBFGSOptions
+  {
+    //number of (s, y) pairs kept
+    int_t historySize = 10;
+
+    size_t maxIter = 500;
+
+    //stop when the flat gradient norm falls below this
+    double gradTol = 1.0e-5;
+
+    //sufficient-decrease and curvature constants of the strong Wolfe conditions
+    double c1 = 1.0e-4;
+
+    double c2 = 0.9;
+
+    //function/gradient evaluations allowed per line search
+    int_t maxLineSearch = 25;
+  };
+
+
+  /*
+   * full-batch L-BFGS over the network's flattened weights, with a strong-Wolfe line search.
+   * every function and gradient evaluation is one predict() and backwardPass().
+   * */
+  class LBFGSTrainer
+  {
+
+  protected:
+
+    LBFGSOptions opts;
+
+    std::deque<Vec> sHist, yHist;
+
+    std::vector<double> lossHistory;
+
+    size_t numEvaluations = 0;
+
+    //H_k g by the two-loop recursion
+    Vec applyInverseHessian(const Vec& g) const;
+
+    //finds a step along d satisfying the strong Wolfe conditions; x, f and g are updated in place
+    bool lineSearch(Network& net, Vec& x, double& f, Vec& g, const Vec& d, double alpha0);
+
+  public:
+
+    LBFGSTrainer(const LBFGSOptions& _opts=LBFGSOptions()) :
+      opts(_opts)
+    {
+      if(opts.historySize <= 0){
+	throw "Error: L-BFGS history size must be positive.";
+      }
+    };
+
+    auto getLossHistory() const
+    {
+      return lossHistory;
+    }
+
+    auto getNumEvaluations() const noexcept
+    {
+      return numEvaluations;
+    }
+
+    //returns true if the gradient tolerance was reached
+    bool train(Network& net,
+	       std::optional<Mat> inputData=std::nullopt,
+	       std::optional<Vec> target=std::nullopt,
+	       bool noprint=false);
+
+  };
+
+}//end namespace NN
+#endif //LBFGS_HPP
@@ -2,6 +2,7 @@
 #define LAYER_HPP
 //#define EIGEN_USE_MKL_ALL
 #define EIGEN_VECTORIZE
+#include "Optimizer.hpp"
 #include <Eigen/Core>
 #include <Eigen/Dense>
 #include <unordered_map>
@@ -13,6 +14,8 @@
 #include <memory>
 #include <omp.h>
 #include <iostream>
+#include <vector>
+#include <algorithm>
 //#include <mkl.h>
 
 namespace NN
@@ -56,11 +59,30 @@ namespace NN
 					 } }
 			    
   };
-  
-  enum class UpdateRule
-    {
-     NesterovAccGrad//simple momentum update
-    };
+
+  /*
+   * second derivatives, also taking pairs of (input, output). only needed when
+   * differentiating through input derivatives of the network (see PlapEnergyLoss)
+   * */
+  static std::unordered_map<std::string, std::function<Mat(std::pair<ConstMatRef,ConstMatRef>)>>
+  ACTIVATION_SECOND_DERIVATIVES = {
+			    {"linear", [](std::pair<ConstMatRef,ConstMatRef> x) -> Mat {
+					 return Mat::Zero(x.second.rows(), x.second.cols());
+				       } },
+			    {"sigmoid", [](std::pair<ConstMatRef,ConstMatRef> x) -> Mat {
+					  return x.second.unaryExpr([](double s){ return s*(1.0 - s)*(1.0 - 2.0*s); });
+					} },
+			    {"tanh",   [](std::pair<ConstMatRef,ConstMatRef> x) -> Mat {
+					 return x.second.unaryExpr([](double t){ return -2.0*t*(1.0 - t*t); });
+				       } },
+			    {"relu", [](std::pair<ConstMatRef,ConstMatRef> x) -> Mat {
+				       return Mat::Zero(x.second.rows(), x.second.cols()); } },
+			    {"softplus", [](std::pair<ConstMatRef,ConstMatRef> x) -> Mat {
+					   return x.first.unaryExpr([](double y){
+								      double s = 1/(exp(-y)+1);
+								      return s*(1.0 - s); });
+					 } }
+  };
 
 
   class Layer
@@ -76,14 +98,23 @@ namespace NN
 
     std::function<Mat(std::pair<ConstMatRef,ConstMatRef>)> activation_grad;
 
+    //empty for custom activations
+    std::function<Mat(std::pair<ConstMatRef,ConstMatRef>)> activation_grad2;
+
     Mat actVals;
 
     Mat weights;
 
-    Mat weightUpdate = Mat::Zero(input_shape.second+1, output_size);
+    OptimizerState optState;
+
+    //true while swapAveragedWeights() has the averaged weights in place of weights
+    bool averageSwapped = false;
 
     Mat gradient;
 
+    //|gradient|^2, taken as the gradient is produced
+    double gradNormSq = 0.0;
+
     Mat outputs;
 
     Mat inputs;
@@ -94,11 +125,24 @@ namespace NN
 
     Mat Jacobian;
 
-    std::tuple<double,double> updateParams;
+    //derivatives of the inputs and of actVals w.r.t. each network input, see forwardTangents()
+    std::vector<Mat> inputTangents;
+
+    std::vector<Mat> actTangents;
+
+    //directional derivatives of the inputs and of actVals along a weight direction, see forwardR()
+    Mat inputR;
+
+    Mat actR;
+
+    OptimizerParams optParams;
 
     std::string name="Layer";
 
-    UpdateRule update=UpdateRule::NesterovAccGrad;
+    //empty for custom activations
+    std::string activationName;
+
+    UpdateRule update=UpdateRule::Momentum;
 
 
   public:
@@ -125,8 +169,7 @@ namespace NN
       input_shape(_input_shape),
       output_size(_output_size)
     {
-      activation = NN::ACTIVATIONS[_activation];
-      activation_grad = NN::ACTIVATION_DERIVATIVES[_activation];
+      setActivation(_activation);
       if(initWeights){
 	weights = Mat::Random(input_shape.second +1, output_size);
       }
@@ -190,6 +233,65 @@ namespace NN
       weights = _weights;
     }
 
+    //bytes kept per batch row by a forward and backward pass: inputs, [inputs,1], actVals,
+    //outputs, err and the activation derivatives
+    int_t activationBytesPerRow() const noexcept
+    {
+      return sizeof(double) * (2 * input_shape.second + 1 + 4 * output_size);
+    }
+
+    //number of trainable parameters, i.e. entries of weights (bias row included)
+    int_t numParams() const noexcept
+    {
+      return weights.size();
+    }
+
+    //row-major copies to and from a slice of a flat parameter vector
+    void copyWeightsTo(double* dst) const
+    {
+      std::copy(weights.data(), weights.data() + weights.size(), dst);
+    }
+
+    void setWeightsFrom(const double* src)
+    {
+      std::copy(src, src + weights.size(), weights.data());
+    }
+
+    //the same for weight rows [first, first + count) only; src points at row first
+    void setWeightRowsFrom(const double* src, int_t first, int_t count)
+    {
+      std::copy(src, src + count * weights.cols(), weights.data() + first * weights.cols());
+    }
+
+    /*
+     * per-sample weight gradients from the last backward pass: row i of J becomes the
+     * row-major flattening of inputMat.row(i)^T * err.row(i). J has numParams() columns.
+     * */
+    void perSampleGradients(MatRef J) const;
+
+    /*
+     * folds this layer's Kronecker factors from the last forward/backward pass into running
+     * averages (K-FAC): A <- decay A + (1-decay) inputMat^T inputMat / batch size and
+     * S <- decay S + (1-decay) err^T err. only the lower triangles are updated.
+     * */
+    void accumulateKroneckerFactors(Mat& A, Mat& S, double decay) const;
+
+    void copyGradientTo(double* dst) const
+    {
+      if(gradient.size() != weights.size()){
+	throw "Error: gradient does not match the weights; run backwardPass first.";
+      }
+      std::copy(gradient.data(), gradient.data() + gradient.size(), dst);
+    }
+
+    void copyGradientRowsTo(double* dst, int_t first, int_t count) const
+    {
+      if(gradient.size() != weights.size()){
+	throw "Error: gradient does not match the weights; run backwardPass first.";
+      }
+      std::copy(gradient.data() + first * gradient.cols(), gradient.data() + (first + count) * gradient.cols(), dst);
+    }
+
     void setInputShape(std::pair<int_t, int_t> _input_shape, bool reinitWeights=true); 
 
     void setOutputSize(int_t _num_outputs) noexcept
@@ -210,29 +312,114 @@ namespace NN
       return gradient;
     }
 
+    //for losses that compute the weight gradient outside backwardPass()
+    void setGradient(const Mat& _gradient)
+    {
+      if(_gradient.rows() != weights.rows() or _gradient.cols() != weights.cols()){
+	throw "Error: gradient must have the shape of the weights.";
+      }
+      gradient = _gradient;
+      gradNormSq = gradient.squaredNorm();
+    }
+
+    //squared norm of the current gradient, kept up to date by backwardPass() and setGradient()
+    double getGradientNormSq() const noexcept
+    {
+      return gradNormSq;
+    }
+
     Mat getErr() const
     {
       return err;
     }
 
+    //derivative of the loss w.r.t. this layer's inputs (err * weights^T without the bias row),
+    //for chaining to layers that are not a Layer
+    Mat getInputGrad() const
+    {
+      return err * weights.topRows(weights.rows() - 1).transpose();
+    }
+
     void setUpdateParams(double learningrate, double momentum) noexcept {
-      updateParams = std::tuple<double,double>(learningrate,momentum);
+      optParams.learningRate = learningrate;
+      optParams.momentum = momentum;
     }
 
     std::tuple<double,double> getUpdateParams() const noexcept
     {
-      return updateParams;
+      return std::make_tuple(optParams.learningRate, optParams.momentum);
+    }
+
+    //switching rules discards the old optimizer state
+    void setOptimizer(UpdateRule rule, const OptimizerParams& params) noexcept
+    {
+      if(rule != update){
+	if(averageSwapped){
+	  swapAveragedWeights();
+	}
+	optState.reset();
+      }
+      update = rule;
+      optParams = params;
+    }
+
+    void setOptimizerParams(const OptimizerParams& params) noexcept
+    {
+      optParams = params;
+    }
+
+    auto getOptimizerParams() const noexcept
+    {
+      return optParams;
+    }
+
+    auto getUpdateRule() const noexcept
+    {
+      return update;
+    }
+
+    //the optimizer's averaged weights (OptimizerParams::averaging), shaped like the weights;
+    //empty before the first averaged update
+    const Mat& getAveragedWeights() const noexcept
+    {
+      return averageSwapped ? weights : optState.average;
+    }
+
+    /*
+     * exchanges the weights with the optimizer's averaged weights in O(1), without copying,
+     * e.g. to evaluate the averaged model; a second call swaps the trained weights back.
+     * updateWeights() throws while the averaged weights are in.
+     * */
+    void swapAveragedWeights();
+
+    //whether swapAveragedWeights() has averaged weights to exchange
+    bool hasAveragedWeights() const noexcept
+    {
+      return optState.average.rows() == weights.rows() and optState.average.cols() == weights.cols();
+    }
+
+    bool averagedWeightsSwapped() const noexcept
+    {
+      return averageSwapped;
     }
 
     void setActivation(std::string actName);
 
+    auto getActivationName() const noexcept
+    {
+      return activationName;
+    }
+
+    //pre-activations whose outputs are y, for the invertible named activations (linear, sigmoid, tanh)
+    Mat invertActivation(ConstMatRef y) const;
+
     void forwardPass(ConstMatRef inputData);
 
     void forwardPass();
 
     Mat makeActDerivs() const noexcept
     {
-      auto actPair = std::make_pair(inputMat, outputs);
+      auto actPair = std::make_pair(actVals, outputs);
       return activation_grad(actPair);
     }
 
@@ -244,14 +431,49 @@ namespace NN
 
     void backwardPass(ConstMatRef loss_grad) noexcept;
 
+    /*
+     * forward pass that also carries derivatives w.r.t. the network inputs: on entry,
+     * tangents[k] is d(inputData)/d(x_k); on exit it is d(outputs)/d(x_k).
+     * */
+    void forwardTangents(ConstMatRef inputData, std::vector<Mat>& tangents);
+
+    /*
+     * backward pass through forwardTangents(). loss_grad is d(loss)/d(outputs) and
+     * tangentGrads[k] is d(loss)/d(tangents[k]) on entry; on exit tangentGrads[k] is the
+     * derivative w.r.t. the input tangents, and getErr()/getInputGrad() refer to the inputs.
+     * */
+    void backwardTangents(ConstMatRef loss_grad, std::vector<Mat>& tangentGrads);
+
+    /*
+     * R-operator forward pass (Pearlmutter): the derivative of this layer's outputs along the
+     * weight direction V (shaped like the weights), given R{inputs}, the derivative of the
+     * inputs along the earlier layers' directions (empty for the first layer). uses the
+     * activations of the last forwardPass().
+     * */
+    Mat forwardR(ConstMatRef inputsR, ConstMatRef V);
+
+    /*
+     * R-operator backward pass through forwardR(). loss_grad is d(loss)/d(outputs) and
+     * loss_gradR its derivative along the direction; writes the derivative of the weight
+     * gradient into gradientR and returns that of the input gradient. gaussNewton drops the
+     * terms with f'' and with V itself, giving the Gauss-Newton product instead of the Hessian's.
+     * leaves err as backwardPass(loss_grad) would.
+     * */
+    Mat backwardR(ConstMatRef loss_grad, ConstMatRef loss_gradR, ConstMatRef V,
+		  MatRef gradientR, bool gaussNewton);
+
     void updateWeights();
 
+    //also scales the weights but not the bias by mult, in the same pass as the update
     void updateWeights(double mult);
 
+    //also scales the gradient by gradScale as the update reads it, e.g. for global-norm clipping
+    void updateWeights(double mult, double gradScale);
+
 
     void updateWeights(const std::tuple<double,double>& params)
     {
-      updateParams = params;
+      setUpdateParams(std::get<0>(params), std::get<1>(params));
       updateWeights();
     }
 
@@ -0,0 +1,85 @@
+#ifndef LEVENBERG_MARQUARDT_HPP
+#define LEVENBERG_MARQUARDT_HPP
+
+#include "Network.hpp"
+#include <Eigen/Core>
+#include <Eigen/Dense>
+#include <vector>
+#include <optional>
+
+namespace NN
+{
+
+  struct LMOptions
+  {
+    size_t maxIter = 200;
+
+    //stop when |J^T r| falls below this
+    double gradTol = 1.0e-8;
+
+    //stop when the loss falls below this
+    double lossTol = 0.0;
+
+    //initial damping, relative to the largest diagonal entry of J^T J
+    double initialDamping = 1.0e-3;
+
+    //damp with diag(J^T J) (Marquardt) instead of the identity (Levenberg)
+    bool marquardtScaling = true;
+
+    //above this many weights the damped system is solved by CG instead of LDLT
+    int_t directMaxParams = 4000;
+
+    int_t cgMaxIter = 250;
+
+    double cgTol = 1.0e-10;
+  };
+
+
+  /*
+   * Levenberg-Marquardt for the L2 loss 0.5 |outputs - target|^2, meant for networks with
+   * a few thousand weights. the residual Jacobian comes from Network::outputJacobian(),
+   * which reuses the layers' err from one backward pass. each step solves
+   *   (J^T J + lambda D) delta = -J^T r
+   * with LDLT, or with Jacobi-preconditioned CG on J^T (J v) for larger networks, and
+   * lambda adapts to the ratio of actual to predicted loss reduction (Nielsen's rule).
+   * */
+  class LevenbergMarquardtTrainer
+  {
+
+  protected:
+
+    LMOptions opts;
+
+    double lambda = 0.0;
+
+    std::vector<double> lossHistory;
+
+    //(J^T J + lambda D) delta = rhs by CG without forming J^T J
+    Vec solveCG(const Mat& J, const Vec& damping, const Vec& rhs) const;
+
+  public:
+
+    LevenbergMarquardtTrainer(const LMOptions& _opts=LMOptions()) :
+      opts(_opts)
+    {};
+
+    auto getLossHistory() const
+    {
+      return lossHistory;
+    }
+
+    auto getDamping() const noexcept
+    {
+      return lambda;
+    }
+
+    //returns true if one of the tolerances was reached
+    bool train(Network& net,
+	       std::optional<Mat> inputData=std::nullopt,
+	       std::optional<Vec> target=std::nullopt,
+	       bool noprint=false);
+
+  };
+
+}//end namespace NN
+#endif //LEVENBERG_MARQUARDT_HPP
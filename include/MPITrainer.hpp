@@ -0,0 +1,218 @@
+#ifndef MPI_TRAINER_HPP
+#define MPI_TRAINER_HPP
+
+//only available when the library is built with MPI (make MPI=1 CXX=mpicxx)
+#ifdef NN_HAVE_MPI
+
+#include "Network.hpp"
+#include "GradientCompression.hpp"
+#include <Eigen/Core>
+#include <mpi.h>
+#include <vector>
+
+namespace NN
+{
+
+  struct MPITrainerOptions
+  {
+    //gradients are reduced in buckets of about this many bytes (at least one layer each)
+    size_t bucketBytes = 1 << 20;
+
+    //rows per rank per step
+    int_t batchSize = 32;
+
+    size_t epochs = 10;
+
+    unsigned seed = 0;
+
+    //lossy gradient compression with error feedback; None reduces the exact gradients
+    CompressionOptions compression;
+
+    /*
+     * ZeRO optimizer-state sharding (uncompressed only): 0 is off; 1 gives each rank the
+     * optimizer state and update of one slice of the flat parameters, the gradients still
+     * allreduced; 2 also reduce-scatters the gradients so each rank receives only its slice
+     */
+    int zeroStage = 0;
+  };
+
+
+  /*
+   * synchronous data-parallel training across the ranks of an MPI communicator: every rank
+   * holds a full copy of the network and trains on its own shard of the data, and after
+   * each backward pass the layer gradients are summed over the ranks, so every rank applies
+   * the same update (as if it had seen the union of the ranks' batches).
+   *
+   * the layers are grouped into buckets of about bucketBytes, last layer first (the order
+   * backprop produces them). through Network::setGradientHook the trainer packs a bucket as
+   * soon as all its layers' gradients exist and starts a non-blocking MPI_Iallreduce on it,
+   * so communication of the later layers overlaps the backward pass of the earlier ones;
+   * step() only waits for the outstanding reductions before the update.
+   *
+   * with compression, each rank encodes its layers' gradients as they become ready
+   * (GradientCompressor) and the buckets' fixed-size payloads are allgathered instead, each
+   * rank summing the decoded payloads in rank order. PowerSGD layers are summed as their
+   * low-rank factors after the backward pass, while the other buckets are in flight.
+   *
+   * with zeroStage 1 or 2, rank r owns slice r of the flat parameter vector (the layers'
+   * weights back to back): only it keeps optimizer state for that slice and updates it, and
+   * the updated slices are allgathered into every rank's weights. stage 2 reduce-scatters
+   * each bucket instead of allreducing it. the slices cut across layers, so the layer-wise
+   * rules (LARS, LAMB), maxNorm and weight averaging are not supported.
+   * */
+  class MPIDataParallelTrainer
+  {
+
+  protected:
+
+    struct Bucket
+    {
+      //layers (forward-order indices) packed back to back in buf
+      std::vector<size_t> layers;
+
+      Vec buf;
+
+      //with compression: this rank's payloads, then every rank's
+      std::vector<unsigned char> payload, gathered;
+
+      //layers whose gradient is not ready yet in the current step
+      size_t pending = 0;
+
+      MPI_Request request = MPI_REQUEST_NULL;
+
+      //uncompressed buckets hold their layers in flat order, from this flat offset
+      int_t flatBegin = 0;
+
+      //ZeRO-2: how much of the bucket each rank receives, and where it lands in shardGrad
+      std::vector<int> scatterCounts;
+
+      int_t shardOffset = 0;
+    };
+
+    MPI_Comm comm;
+
+    int rank = 0, size = 1;
+
+    MPITrainerOptions opts;
+
+    std::vector<Bucket> buckets;
+
+    //(rows, cols) of each layer's weights when the buckets were laid out
+    std::vector<std::pair<int_t, int_t>> shape;
+
+    //bucketOf[l], offsetOf[l]: where layer l's gradient lives (offsets in payload bytes
+    //with compression)
+    std::vector<size_t> bucketOf, offsetOf;
+
+    GradientCompressor compressor;
+
+    //layers PowerSGD compresses, in no bucket
+    std::vector<size_t> lowRankLayers;
+
+    //ZeRO: where each layer starts in the flat parameters, and rank r's slice
+    //[shardBounds[r], shardBounds[r + 1])
+    std::vector<int_t> flatOffset, shardBounds;
+
+    //ZeRO: the summed gradient of this rank's slice
+    Vec shardGrad;
+
+    //ZeRO: optimizer state of each layer's part of this rank's slice (empty elsewhere)
+    std::vector<OptimizerState> shardState;
+
+    //ZeRO: the rule each layer's shardState belongs to; a new rule starts from fresh state,
+    //as Layer::setOptimizer does
+    std::vector<UpdateRule> shardRule;
+
+    //bytes this rank has contributed to gradient reductions, and the dense equivalent
+    size_t bytesSent = 0, bytesDense = 0;
+
+    //per-sample loss per epoch over all ranks
+    std::vector<double> epochLoss;
+
+    //seconds step() spent blocked on reductions that had not finished during backprop
+    double waitSeconds = 0.0;
+
+    void makeBuckets(Network& net);
+
+    //whether net's layers still have the shapes the buckets were laid out for
+    bool bucketsMatch(Network& net) const;
+
+    void gradientReady(size_t index, const Layer& layer);
+
+    //sums the PowerSGD layers' gradients over the ranks
+    void reduceLowRank(Network& net);
+
+    //ZeRO: updates this rank's slice from shardGrad and allgathers the weights
+    void shardedUpdate(Network& net);
+
+  public:
+
+    MPIDataParallelTrainer(MPI_Comm _comm=MPI_COMM_WORLD,
+			   const MPITrainerOptions& _opts=MPITrainerOptions());
+
+    auto getRank() const noexcept
+    {
+      return rank;
+    }
+
+    auto getSize() const noexcept
+    {
+      return size;
+    }
+
+    auto getNumBuckets() const noexcept
+    {
+      return buckets.size();
+    }
+
+    auto getEpochLoss() const
+    {
+      return epochLoss;
+    }
+
+    auto getWaitSeconds() const noexcept
+    {
+      return waitSeconds;
+    }
+
+    auto getBytesSent() const noexcept
+    {
+      return bytesSent;
+    }
+
+    auto getBytesDense() const noexcept
+    {
+      return bytesDense;
+    }
+
+    //ZeRO: entries of optimizer state (moments) this rank holds for its slice
+    size_t shardStateSize() const noexcept;
+
+    //dense bytes per byte sent so far
+    double compressionRatio() const noexcept
+    {
+      return bytesSent > 0 ? static_cast<double>(bytesDense) / bytesSent : 1.0;
+    }
+
+    //copies rank 0's weights to every rank
+    void broadcastWeights(Network& net) const;
+
+    /*
+     * one synchronous update on this rank's batch (every rank must call it); returns the
+     * loss summed over all ranks' batches
+     * */
+    double step(Network& net, ConstMatRef batchInputs, Eigen::Ref<const Vec> batchTarget);
+
+    /*
+     * trains on this rank's shard (X, y) after broadcasting rank 0's weights. every epoch has
+     * the same number of steps on all ranks (that of the largest shard); smaller shards
+     * wrap around to their start to fill their last batches.
+     * */
+    void train(Network& net, ConstMatRef X, Eigen::Ref<const Vec> y, bool noprint=false);
+
+  };
+
+}//end namespace NN
+
+#endif //NN_HAVE_MPI
+#endif //MPI_TRAINER_HPP
@@ -0,0 +1,117 @@
+#ifndef MINI_BATCH_HPP
+#define MINI_BATCH_HPP
+
+#include "Network.hpp"
+#include "DataParallel.hpp"
+#include <Eigen/Core>
+#include <vector>
+#include <random>
+#include <memory>
+
+namespace NN
+{
+
+  //what to do with the rows left over when batchSize does not divide the data set
+  enum class FinalBatch
+    {
+     Partial,//one smaller batch
+     DropLast,//skip them this epoch; they land elsewhere after the next shuffle
+     Pad//fill the batch up from the start of the permutation
+    };
+
+  struct MiniBatchOptions
+  {
+    int_t batchSize = 32;
+
+    size_t epochs = 10;
+
+    bool shuffle = true;
+
+    FinalBatch finalBatch = FinalBatch::Partial;
+
+    //decay of the running (exponentially averaged) per-sample loss
+    double runningDecay = 0.99;
+
+    unsigned seed = 0;
+
+    //bytes of activations a batch may use; larger batches accumulate gradients over
+    //micro-batches (Network::accumulateAndUpdate). 0 means no limit
+    size_t memoryBudget = 0;
+
+    //above 1, each batch is split across a DataParallelTrainer's threads (memoryBudget is
+    //then not applied)
+    int numThreads = 1;
+  };
+
+
+  /*
+   * epoch-based mini-batch training. the data set is only referenced: every epoch shuffles
+   * an index permutation and gathers each batch's rows into one buffer reused for the whole
+   * run, which is handed to the network with Network::setBatch(). each batch gets one
+   * predict/backwardPass/updateWeights with the network's own update rule. the L2 loss and
+   * its gradient are sums over the batch, so the learning rate is per sample.
+   * */
+  class MiniBatchTrainer
+  {
+
+  protected:
+
+    MiniBatchOptions opts;
+
+    std::mt19937_64 gen;
+
+    std::vector<int_t> permutation;
+
+    Mat batchInputs;
+
+    Vec batchTarget;
+
+    //per-sample loss of every batch, its running average, and the mean of each epoch
+    std::vector<double> batchLoss;
+
+    std::vector<double> runningLoss;
+
+    std::vector<double> epochLoss;
+
+    std::unique_ptr<DataParallelTrainer> parallel;
+
+    //gathers rows permutation[start, start + batchSize) into the buffers
+    void gatherBatch(ConstMatRef X, Eigen::Ref<const Vec> y, int_t start, int_t rows);
+
+  public:
+
+    MiniBatchTrainer(const MiniBatchOptions& _opts=MiniBatchOptions()) :
+      opts(_opts),
+      gen(_opts.seed)
+    {};
+
+    auto getBatchLoss() const
+    {
+      return batchLoss;
+    }
+
+    auto getRunningLoss() const
+    {
+      return runningLoss;
+    }
+
+    auto getEpochLoss() const
+    {
+      return epochLoss;
+    }
+
+    //the order of the last epoch
+    const std::vector<int_t>& getPermutation() const noexcept
+    {
+      return permutation;
+    }
+
+    //batches per epoch for n rows under the final-batch policy
+    int_t stepsPerEpoch(int_t n) const noexcept;
+
+    void train(Network& net, ConstMatRef X, Eigen::Ref<const Vec> y, bool noprint=false);
+
+  };
+
+}//end namespace NN
+#endif //MINI_BATCH_HPP
@@ -22,7 +22,7 @@
 
 namespace NN
 {
-  std::unordered_map<std::string, std::function<double(Eigen::Ref<const Vec>, Eigen::Ref<const Vec>)>>
+  static std::unordered_map<std::string, std::function<double(Eigen::Ref<const Vec>, Eigen::Ref<const Vec>)>>
   VECTOR_LOSS = {
 		 {"L2", [](Eigen::Ref<const Vec> pred, Eigen::Ref<const Vec> obs) -> double {
 			  Vec resid = pred - obs;
@@ -31,7 +31,7 @@ namespace NN
 		 }
   };
 
-  std::unordered_map<std::string, std::function<Vec(Eigen::Ref<const Vec>, Eigen::Ref<const Vec>)>>
+  static std::unordered_map<std::string, std::function<Vec(Eigen::Ref<const Vec>, Eigen::Ref<const Vec>)>>
   VECTOR_LOSS_DERIVATIVE = {
 											  {"L2", [](Eigen::Ref<const Vec> pred, Eigen::Ref<const Vec> obs) -> Vec { return pred - obs; } }
   };
@@ -68,7 +68,19 @@ namespace NN
 
     Mat gradient;
 
-    UpdateRule update = UpdateRule::NesterovAccGrad;
+    UpdateRule update = UpdateRule::Momentum;
+
+    //see setGradientHook()
+    std::function<void(size_t, Layer&)> gradientHook;
+
+    //see setGradientClipping()
+    double clipNorm = 0.0;
+
+    //runs data through the layers and returns the last layer's outputs
+    Mat forwardLayers(ConstMatRef data);
+
+    //backpropagates outputGrad, the derivative of the loss w.r.t. the last layer's outputs
+    void backwardLayers(ConstMatRef outputGrad);
 
   public:
 
@@ -144,12 +156,20 @@ namespace NN
 
     };
 
+    virtual ~Network() = default;
+
 
     auto getLayers() const noexcept
     {
       return layers;
     }
 
+    //in-place access for losses and trainers that drive the layers themselves
+    std::list<Layer>& getLayersRef() noexcept
+    {
+      return layers;
+    }
+
     auto getLayerInputShapes() const noexcept
     {
       return layer_input_shapes;
@@ -190,6 +210,41 @@ namespace NN
       return gradient;
     }
 
+    //norm of the gradient of all layers together, from the norms each layer took as its
+    //gradient was produced (or set), so it costs no pass over the gradients
+    double getGradientNorm() const noexcept
+    {
+      double sq = 0.0;
+      for(const auto& l : layers){
+	sq += l.getGradientNormSq();
+      }
+      return std::sqrt(sq);
+    }
+
+    /*
+     * global-norm clipping: when the gradient of all layers together is longer than maxNorm,
+     * updateWeights() scales it down to maxNorm inside the optimizer pass, so clipping reads
+     * the gradients no more than the update does. 0 turns it off.
+     * */
+    void setGradientClipping(double maxNorm)
+    {
+      if(maxNorm < 0.0){
+	throw "Error: clipping norm must be non-negative.";
+      }
+      clipNorm = maxNorm;
+    }
+
+    auto getGradientClipping() const noexcept
+    {
+      return clipNorm;
+    }
+
+    //the factor clipping applies to a gradient of norm gradNorm
+    double clipScale(double gradNorm) const noexcept
+    {
+      return (clipNorm > 0.0 and gradNorm > clipNorm) ? clipNorm / gradNorm : 1.0;
+    }
+
     auto getLossHistory() const 
     {
       return trainingLoss;
@@ -209,6 +264,12 @@ namespace NN
 
     void setTarget(Eigen::Ref<const Vec> _target, bool overrideTargetSize=false);
 
+    /*
+     * sets the inputs and target for a batch of any number of rows (same features), keeping
+     * the weights; for drivers that feed the network batches of a larger data set.
+     * */
+    void setBatch(ConstMatRef batchInputs, Eigen::Ref<const Vec> batchTarget);
+
     void setLayers(const std::list<Layer>& newLayers);
 
     //moves layers onto end of list
@@ -240,6 +301,68 @@ namespace NN
     }
 
     void setWeights(const std::list<Mat>& weights);
+
+    //total number of weights over all layers
+    int_t numParams() const noexcept
+    {
+      int_t n = 0;
+      for(const auto& l : layers){
+	n += l.numParams();
+      }
+      return n;
+    }
+
+    //all layers' weights (then gradients) concatenated, each layer row-major, first layer first
+    Vec getFlatWeights() const;
+
+    void setFlatWeights(Eigen::Ref<const Vec> params);
+
+    Vec getFlatGradient() const;
+
+    /*
+     * loss and flat gradient at the given flat weights, for optimizers that work on the
+     * parameter vector as a whole. leaves the network's weights set to params.
+     * */
+    double lossAndGradient(Eigen::Ref<const Vec> params, Eigen::Ref<Vec> grad);
+
+    /*
+     * Jacobian of the outputs (one per sample) w.r.t. the flat weights at the current weights,
+     * (batch size) x numParams(), from one backward pass seeded with ones: each sample's output
+     * only depends on its own row, so every layer's err holds all the per-sample derivatives.
+     * call predict() first. leaves the layers' gradients holding the sum of the rows.
+     * */
+    Mat outputJacobian();
+
+    /*
+     * product of the loss Hessian w.r.t. the flat weights with v at the current weights, by
+     * an R-operator forward pass and backward pass through the layers: about the cost of two
+     * gradients, and the Hessian is never formed. with gaussNewton, the Gauss-Newton matrix
+     * J^T J instead, which is positive semidefinite. the loss is taken to be L2, whose Hessian
+     * w.r.t. the outputs is the identity. call predict() first.
+     * */
+    Vec hessianVectorProduct(Eigen::Ref<const Vec> v, bool gaussNewton=false);
+
+    /*
+     * hook(index, layer) runs inside the backward pass as soon as each layer's gradient is
+     * ready, last layer first (index counts from the first layer), e.g. to start
+     * communicating it while the earlier layers are still running. an empty function clears it.
+     * */
+    void setGradientHook(const std::function<void(size_t, Layer&)>& hook)
+    {
+      gradientHook = hook;
+    }
+
+    //backward pass from an arbitrary d(loss)/d(outputs), e.g. ones for output derivatives
+    void backwardFrom(ConstMatRef outputGrad)
+    {
+      backwardLayers(outputGrad);
+    }
+
+    //outputs - target from the last predict()
+    auto getResidual() const
+    {
+      return resid;
+    }
     
     //gives all layers the same update params
     void setUpdateParams(double lr, double p) noexcept
@@ -251,6 +374,18 @@ namespace NN
     //different args for each layer
     void setUpdateParams(const std::list<std::tuple<double,double>>& argsList);
 
+    //same update rule and hyperparameters for each layer
+    void setOptimizer(UpdateRule rule, const OptimizerParams& params) noexcept
+    {
+      update = rule;
+      for(auto& l : layers){
+	l.setOptimizer(rule, params);
+      }
+    }
+
+    //same update rule, different hyperparameters for each layer
+    void setOptimizer(UpdateRule rule, const std::list<OptimizerParams>& paramsList);
+
     //same activation for each layer
     void setActivations(std::string activations) noexcept
     {
@@ -275,20 +410,21 @@ namespace NN
     }
 
     //runs a forward pass through the layers, returning the output if desired
-    void predict(std::optional<Mat> inputData=std::nullopt,
-		 std::optional<Vec> _target=std::nullopt);
+    virtual void predict(std::optional<Mat> inputData=std::nullopt,
+			 std::optional<Vec> _target=std::nullopt);
 		
     //same as predict(), but returns the output
     Vec predictVal(std::optional<Mat> inputData=std::nullopt,
 		   std::optional<Vec> _target=std::nullopt);
 
     //computes gradient of network
-    void backwardPass();
+    virtual void backwardPass();
 
     void updateWeights()
     {
+      const double scale = clipScale(getGradientNorm());
       for(auto& l : layers){
-	l.updateWeights();
+	l.updateWeights(1.0, scale);
       }
     }
 
@@ -304,6 +440,68 @@ namespace NN
       updateWeights();
     }
 
+    //swaps every layer's weights with its optimizer's averaged weights (EMA/SWA) without
+    //copying, e.g. to evaluate the averaged model; call again to swap the trained weights back.
+    //throws before swapping anything unless every layer can swap the same way
+    void swapAveragedWeights()
+    {
+      for(const auto& l : layers){
+	if(not l.hasAveragedWeights()){
+	  throw "Error: a layer has no averaged weights; set OptimizerParams::averaging on every layer and update first.";
+	}
+	if(l.averagedWeightsSwapped() != layers.front().averagedWeightsSwapped()){
+	  throw "Error: some layers have their averaged weights swapped in and some don't.";
+	}
+      }
+      for(auto& l : layers){
+	l.swapAveragedWeights();
+      }
+    }
+
+    bool averagedWeightsSwapped() const noexcept
+    {
+      return not layers.empty() and layers.front().averagedWeightsSwapped();
+    }
+
+    //[outputs of every layer but the last, 1] for data: the last layer's design matrix
+    Mat outputLayerFeatures(ConstMatRef data);
+
+    /*
+     * with all other layers fixed, sets the last layer's weights to the ridge solution
+     *   (H^T H + lambda I) W = H^T y,   H = outputLayerFeatures(inputs)
+     * (bias row regularized too). H^T H and H^T y are accumulated over row blocks of
+     * batchSize rows (0: all at once) so H is never formed for the whole data set, and the
+     * system is solved by Cholesky. sigmoid and tanh outputs are fit to the inverse
+     * activation of the target.
+     * */
+    void solveOutputLayer(double lambda,
+			  int_t batchSize=0,
+			  std::optional<Mat> inputData=std::nullopt,
+			  std::optional<Vec> _target=std::nullopt);
+
+    //estimated bytes per batch row of all layers' activations plus the network's own buffers
+    int_t activationBytesPerRow() const noexcept
+    {
+      int_t bytes = sizeof(double) * (input_shape.second + 4);
+      for(const auto& l : layers){
+	bytes += l.activationBytesPerRow();
+      }
+      return bytes;
+    }
+
+    //largest micro-batch whose activations fit in memoryBytes, capped at batchRows
+    int_t microBatchSize(size_t memoryBytes, int_t batchRows) const;
+
+    /*
+     * one update over a logical batch too large to run at once: it is split into the
+     * largest micro-batches that fit memoryBytes, their gradients are summed (the loss is a
+     * sum, so this is the full-batch gradient), and updateWeights() runs once. returns the
+     * loss over the whole batch.
+     * */
+    double accumulateAndUpdate(ConstMatRef batchInputs, Eigen::Ref<const Vec> batchTarget,
+			       size_t memoryBytes);
+
+    //updates until the global gradient norm (getGradientNorm()) is at most stopTol
     void train(double stopTol=1.0e-5, 
 	       size_t maxIter=1.0e3,
 	       std::optional<Mat> inputData=std::nullopt,
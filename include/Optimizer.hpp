@@ -0,0 +1,132 @@
+#ifndef OPTIMIZER_HPP
+#define OPTIMIZER_HPP
+
+#include <Eigen/Core>
+#include <cstdint>
+
+namespace NN
+{
+
+  enum class UpdateRule
+    {
+     Momentum,//heavy-ball momentum, the original update
+     NesterovAccGrad,//Nesterov accelerated gradient
+     Adam,
+     AdamW,//Adam with decoupled weight decay
+     RMSProp,
+     AdaGrad,
+     LARS,//momentum with a layer-wise trust ratio
+     LAMB//AdamW with a layer-wise trust ratio
+    };
+
+  //running average of the weights kept by the update kernels
+  enum class Averaging
+    {
+     None,
+     EMA,//exponential moving average with decay emaDecay
+     SWA//stochastic weight averaging: equal-weight mean of every swaPeriod-th step from swaStart
+    };
+
+  /*
+   * hyperparameters for every UpdateRule; each rule reads only the fields it needs.
+   * RMSProp uses beta2 as its squared-gradient decay and momentum for its optional
+   * momentum buffer; AdamW uses weightDecay. LARS and LAMB scale each block's step by the
+   * trust ratio |w| / |update|, LARS also by trustCoefficient; both use weightDecay.
+   * averaging and the regularizers (l2, decoupledDecay, l1, maxNorm) apply to every rule
+   * and skip the bias row; see applyUpdate.
+   * */
+  struct OptimizerParams
+  {
+    double learningRate = 1.0e-3;
+
+    double momentum = 0.0;
+
+    double beta1 = 0.9;
+
+    double beta2 = 0.999;
+
+    double epsilon = 1.0e-8;
+
+    double weightDecay = 0.0;
+
+    double trustCoefficient = 1.0e-3;
+
+    //coupled L2: l2 * w is added to the gradient before the rule sees it
+    double l2 = 0.0;
+
+    //decoupled decay for any rule: w *= 1 - learningRate * decoupledDecay after the step
+    double decoupledDecay = 0.0;
+
+    //L1 by its proximal step: soft-thresholds the new weights by learningRate * l1
+    double l1 = 0.0;
+
+    //caps the norm of each column (a unit's incoming weights) at maxNorm; 0 turns it off
+    double maxNorm = 0.0;
+
+    Averaging averaging = Averaging::None;
+
+    double emaDecay = 0.999;
+
+    //SWA averages the weights after updates swaStart, swaStart + swaPeriod, ... (counting from 1)
+    int_fast64_t swaStart = 1;
+
+    int_fast64_t swaPeriod = 1;
+  };
+
+  //row-major like NN::Mat, so a Layer can swap it with its weights in O(1)
+  using AverageMat = Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
+
+  //per-parameter-block state, sized on the first update
+  struct OptimizerState
+  {
+    //velocity for the momentum rules, first moment for Adam
+    Eigen::VectorXd moment1;
+
+    //running squared gradient for Adam, RMSProp and AdaGrad
+    Eigen::VectorXd moment2;
+
+    int_fast64_t step = 0;
+
+    //averaged weights (EMA starts from the weights before the first update); any shape
+    //with one entry per weight
+    AverageMat average;
+
+    //steps folded into an SWA average
+    int_fast64_t numAveraged = 0;
+
+    //scratch for the column norms of maxNorm
+    Eigen::VectorXd colNormSq;
+
+    void reset()
+    {
+      moment1.resize(0);
+      moment2.resize(0);
+      average.resize(0, 0);
+      colNormSq.resize(0);
+      step = 0;
+      numAveraged = 0;
+    }
+  };
+
+  /*
+   * one fused pass over n parameters: reads the gradient and optimizer state and writes
+   * the state and weights in place, with no temporaries; the same pass regularizes each
+   * new weight and folds it into state.average. LARS and LAMB need the norms of the whole
+   * block first, so they make a second pass. call once per layer so that the trust ratios
+   * are layer-wise.
+   *
+   * only the first numRegularized weights (all if negative) are regularized, so a layer
+   * passes its weights without the bias row. for maxNorm they are rows of cols entries
+   * (0: one vector); the pass sums the column norms as it goes, and only columns over the
+   * cap are touched again. mult scales the regularized weights after the step, fusing
+   * Layer::updateWeights(double mult), and gradScale scales the gradient as it is read,
+   * fusing global-norm clipping (Network::setGradientClipping).
+   * */
+  void applyUpdate(UpdateRule rule, const OptimizerParams& params,
+		   double* weights, const double* gradient,
+		   OptimizerState& state, int_fast64_t n,
+		   int_fast64_t numRegularized=-1, int_fast64_t cols=0, double mult=1.0,
+		   double gradScale=1.0);
+
+}//end namespace NN
+#endif //OPTIMIZER_HPP
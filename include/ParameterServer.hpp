@@ -0,0 +1,151 @@
+#ifndef PARAMETER_SERVER_HPP
+#define PARAMETER_SERVER_HPP
+
+#include "Network.hpp"
+#include <Eigen/Core>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace NN
+{
+
+  struct ParameterServerOptions
+  {
+    //path of the Unix domain socket the server listens on
+    std::string socketPath = "/tmp/nn_parameter_server.sock";
+
+    int numWorkers = 2;
+
+    //how many pushes a worker may be ahead of the slowest unfinished worker
+    int_t staleness = 2;
+  };
+
+
+  /*
+   * asynchronous training through a parameter server on one machine. the server process
+   * holds the master network; worker processes (ParameterClient) pull its weights, compute
+   * a gradient on their own data, and push it back over a Unix domain socket, and the
+   * server applies each push with the master network's optimizer as it arrives, so fast
+   * workers do not wait for slow ones.
+   *
+   * staleness is bounded (stale synchronous parallel): each worker's clock counts its
+   * pushes, and a pull from a worker more than staleness pushes ahead of the slowest
+   * unfinished worker is answered only once that worker catches up. staleness 0 makes the
+   * workers take turns in lockstep rounds.
+   * */
+  class ParameterServer
+  {
+
+  protected:
+
+    ParameterServerOptions opts;
+
+    Network master;
+
+    int listenFd = -1;
+
+    std::vector<int_t> clock;
+
+    std::vector<bool> finished;
+
+    //number of updates applied to master
+    int_t version = 0;
+
+    //pulls held back by the staleness bound, and the largest clock gap ever served
+    int_t numDelayedPulls = 0, maxServedGap = 0;
+
+    int_t minClock() const;
+
+  public:
+
+    //binds and listens on opts.socketPath, so workers may connect before serve() runs
+    ParameterServer(const Network& net, const ParameterServerOptions& _opts=ParameterServerOptions());
+
+    ~ParameterServer();
+
+    ParameterServer(const ParameterServer&) = delete;
+
+    ParameterServer& operator=(const ParameterServer&) = delete;
+
+    //serves until every worker has connected and said it is done
+    void serve();
+
+    const Network& getNetwork() const noexcept
+    {
+      return master;
+    }
+
+    auto getVersion() const noexcept
+    {
+      return version;
+    }
+
+    auto getClocks() const
+    {
+      return clock;
+    }
+
+    auto getNumDelayedPulls() const noexcept
+    {
+      return numDelayedPulls;
+    }
+
+    auto getMaxServedGap() const noexcept
+    {
+      return maxServedGap;
+    }
+
+  };
+
+
+  class ParameterClient
+  {
+
+  protected:
+
+    int fd = -1;
+
+    int workerId;
+
+    int_t clock = 0;
+
+    void sendMessage(std::uint32_t type, const double* data, std::int64_t count);
+
+  public:
+
+    //connects to a server at socketPath, retrying for up to timeoutSeconds while it starts
+    ParameterClient(const std::string& socketPath, int _workerId, double timeoutSeconds=10.0);
+
+    ~ParameterClient();
+
+    ParameterClient(const ParameterClient&) = delete;
+
+    ParameterClient& operator=(const ParameterClient&) = delete;
+
+    //pushes so far
+    auto getClock() const noexcept
+    {
+      return clock;
+    }
+
+    //copies the master weights into net, waiting if this worker is too far ahead
+    void pull(Network& net);
+
+    //sends net's gradient from its last backward pass
+    void push(const Network& net);
+
+    //tells the server this worker has finished; further calls throw
+    void done();
+
+    /*
+     * mini-batch training against the server: per batch of a shuffled epoch, pull, forward
+     * and backward on the batch, push; then done()
+     * */
+    void train(Network& net, ConstMatRef X, Eigen::Ref<const Vec> y, int_t batchSize=32,
+	       size_t epochs=10, unsigned seed=0);
+
+  };
+
+}//end namespace NN
+#endif //PARAMETER_SERVER_HPP
@@ -0,0 +1,110 @@
+#ifndef PLAP_ENERGY_HPP
+#define PLAP_ENERGY_HPP
+
+#include "Layer.hpp"
+#include "Network.hpp"
+#include <Eigen/Core>
+#include <vector>
+#include <utility>
+#include <cmath>
+
+namespace NN
+{
+
+  //quadrature points (one per row) and their weights
+  struct CollocationGrid
+  {
+    Mat points;
+
+    Vec weights;
+
+    //tensor-product trapezoid rule with counts[d] >= 2 points along dimension d
+    static CollocationGrid structured(const Vec& lower, const Vec& upper,
+				      const std::vector<int_t>& counts);
+  };
+
+
+  /*
+   * Deep-Ritz energy of the scalar field u represented by a Network,
+   *   E[u] = sum_i w_i ( |grad u(x_i)|^p / p - f_i u(x_i) ),
+   * over a batch of collocation points. grad u comes from one forward pass that carries
+   * the input derivatives of every layer (Layer::forwardTangents), and d(E)/d(weights)
+   * from the matching backward pass, so no finite differences or per-point predict calls
+   * are needed. the quadrature weights are applied in the same pass as the reduction.
+   * */
+  class PlapEnergyLoss
+  {
+
+  protected:
+
+    double p;
+
+    CollocationGrid grid;
+
+    Vec f;
+
+    Vec u;
+
+    //grad u at each point, one row per point
+    Mat gradU;
+
+    double energy = 0.0;
+
+    std::vector<double> energyHistory;
+
+  public:
+
+    PlapEnergyLoss(double _p, const CollocationGrid& _grid, const Vec& _f) :
+      p(_p),
+      grid(_grid),
+      f(_f)
+    {
+      if(p <= 1.0){
+	throw "Error: p-Laplacian exponent must be greater than 1.";
+      }
+      if(grid.points.rows() != grid.weights.size() or f.size() != grid.weights.size()){
+	throw "Error: need one quadrature weight and one f value per collocation point.";
+      }
+    };
+
+    auto getP() const noexcept
+    {
+      return p;
+    }
+
+    auto getEnergy() const noexcept
+    {
+      return energy;
+    }
+
+    auto getU() const
+    {
+      return u;
+    }
+
+    auto getGradU() const
+    {
+      return gradU;
+    }
+
+    auto getEnergyHistory() const
+    {
+      return energyHistory;
+    }
+
+    //u and grad u at the collocation points, and the energy
+    double evaluate(Network& net);
+
+    /*
+     * as evaluate(), and also leaves d(E)/d(weights) in each layer's gradient,
+     * so that net.updateWeights() takes a step on the energy
+     * */
+    double evaluateWithGradient(Network& net);
+
+    //momentum descent on the energy with the network's update parameters
+    void train(Network& net, double stopTol=1.0e-8, size_t maxIter=1000);
+
+  };
+
+}//end namespace NN
+#endif //PLAP_ENERGY_HPP
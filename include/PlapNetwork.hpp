@@ -3,6 +3,8 @@
 
 #include "Layer.hpp"
 #include "Network.hpp"
+#include <initializer_list>
+#include <optional>
 #include <utility>
 #include <string>
 #include <cmath>
@@ -10,8 +12,14 @@
 namespace NN
 {
 
-	template<UpdateRule update, typename... updateArgs>
-	class PlapFinalLayer : protected Layer<update, updateArgs...>
+	/*
+	 * p-Laplacian output layer: for each sample (row) z of its input,
+	 *   output = a * |z|^(p-2) = a * r^((p-2)/2),  r = |z|^2.
+	 * it has no weights; the squared norms and the power are each one vectorized pass.
+	 * Layer is a protected base: its non-virtual passes would run the dense-layer code
+	 * through a Layer&, so a PlapFinalLayer is not usable as one.
+	 * */
+	class PlapFinalLayer : protected Layer
 	{
 	protected:
 
@@ -19,79 +27,134 @@ namespace NN
 
 		double a = 1.0;
 
-		Vec actVals;
-		
-		std::function<double(double)> activation;
-
-		std::function<Mat(std::pair<Mat, Mat>)> activation_grad;
+		//r = |z|^2 for each sample
+		Vec sqNorms;
 
 		Vec output;
 
-		Mat inputs;
-
-		Mat Jacobian;
+		//d(loss)/d(inputs), one row per sample
+		Mat inputGrad;
 
 	public:
 		PlapFinalLayer(std::pair<int_t, int_t> _input_shape,
-					   int_t num_outputs=1,
-					   std::string _activation="sigmoid",
-					   double _p=2.0,
-					   double _a=1.0) :
-								Layer<update, updateArgs...>(_input_shape, num_outputs, _activation, false),
-								p(_p),
-								a(_a),
-								activation(ACTIVATIONS[_activation]),
-								activation_grad(ACTIVATION_DERIVATIVES[_activation])
+			       double _p=2.0,
+			       double _a=1.0) :
+			Layer(_input_shape, 1, "linear", false),
+			p(_p),
+			a(_a)
 		{
-
+			if(p <= 1.0){
+				throw "Error: p-Laplacian exponent must be greater than 1.";
+			}
 		};
 
-		void setInputs(const Mat& _inputs)
+		auto getP() const noexcept
+		{
+			return p;
+		}
+
+		auto getA() const noexcept
+		{
+			return a;
+		}
+
+		void setP(double _p)
+		{
+			if(_p <= 1.0){
+				throw "Error: p-Laplacian exponent must be greater than 1.";
+			}
+			p = _p;
+		}
+
+		void setA(double _a) noexcept
+		{
+			a = _a;
+		}
+
+		void setInputs(ConstMatRef _inputs)
 		{
-			Layer<update, updateArgs...>::setInputs(_inputs, false);
 			inputs = _inputs;
+			input_shape = std::make_pair(inputs.rows(), inputs.cols());
 		}
 
-		auto getOutput()
+		auto getOutput() const
 		{
 			return output;
 		}
 
-		void forwardPass()
+		Mat getInputGrad() const
 		{
-			actVals = Vec::Zero(inputs.cols());
-			int_t count = 0;
-			for(auto& col : inputs.colwise()){
-				double aval = col.squaredNorm();
-				actVals[count] = aval;
-				count++;
-			}
-			//make activation
-			output = actVals;
-			count = 0;
-			for(auto& it : actVals){
-				output[count] = a * pow(it, (p-2)*0.5);
-				count++;
-			}
+			return inputGrad;
 		}
 
+		void forwardPass();
 
-		void forwardPass(const Mat& inputData)
+		void forwardPass(ConstMatRef inputData)
 		{
 			setInputs(inputData);
 			forwardPass();
 		}
 
-		void computeJacobian()
+		//row i is d(output_i)/d(z_i) = 2 a e r_i^(e-1) z_i, with e = (p-2)/2
+		Mat computeJacobian();
+
+		//loss_grad is d(loss)/d(output), one entry per sample
+		void backwardPass(Eigen::Ref<const Vec> loss_grad);
+
+	};
+
+
+	/*
+	 * Network whose dense layers produce a vector z per sample, followed by a
+	 * PlapFinalLayer, so each sample's output is a |z|^(p-2).
+	 * */
+	class PlapNetwork : public Network
+	{
+	protected:
+
+		PlapFinalLayer plapLayer;
+
+	public:
+
+		PlapNetwork(std::string activation,
+			    std::string loss,
+			    std::initializer_list<Layer> _layers,
+			    double p=2.0,
+			    double a=1.0) :
+			Network(activation, loss, _layers),
+			plapLayer(std::make_pair(layers.back().getInputShape().first,
+						 layers.back().getOutputSize()), p, a)
+		{
+			num_outputs = 1;
+		};
+
+		const PlapFinalLayer& getPlapLayer() const noexcept
+		{
+			return plapLayer;
+		}
+
+		void setP(double p)
 		{
-			
+			plapLayer.setP(p);
+		}
 
+		void setA(double a) noexcept
+		{
+			plapLayer.setA(a);
+		}
 
+		//one target value per sample
+		void setTarget(Eigen::Ref<const Vec> _target)
+		{
+			target = _target;
+		}
 
+		void predict(std::optional<Mat> inputData=std::nullopt,
+			     std::optional<Vec> _target=std::nullopt) override;
 
+		void backwardPass() override;
 
 	};
 
-
 }
 #endif //PLAP_NETWORK_HPP
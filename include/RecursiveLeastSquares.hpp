@@ -0,0 +1,60 @@
+#ifndef RECURSIVE_LEAST_SQUARES_HPP
+#define RECURSIVE_LEAST_SQUARES_HPP
+
+#include "Network.hpp"
+#include <Eigen/Core>
+#include <Eigen/Dense>
+
+namespace NN
+{
+
+  /*
+   * recursive least squares on a network's last layer, the streaming counterpart of
+   * Network::solveOutputLayer(): each batch of new rows updates the last layer's weights and
+   * P = (H^T H + lambda I)^-1 in place, at O(p^2 m + m^3) for p weights and m rows, without
+   * revisiting old data. with forgetting = 1 and no warm start, the weights after any number
+   * of batches equal solveOutputLayer(lambda) on their concatenation; forgetting < 1 weights
+   * older rows down geometrically.
+   * */
+  class RecursiveLeastSquares
+  {
+
+  protected:
+
+    double lambda;
+
+    double forgetting;
+
+    //regularize toward the weights the layer has at the first update instead of zero
+    bool warmStart;
+
+    Mat P;
+
+    int_t numSamples = 0;
+
+  public:
+
+    RecursiveLeastSquares(double _lambda, double _forgetting=1.0, bool _warmStart=false) :
+      lambda(_lambda),
+      forgetting(_forgetting),
+      warmStart(_warmStart)
+    {};
+
+    auto getNumSamples() const noexcept
+    {
+      return numSamples;
+    }
+
+    //starts over with P = I / lambda at the next update
+    void reset() noexcept
+    {
+      P.resize(0, 0);
+      numSamples = 0;
+    }
+
+    void update(Network& net, ConstMatRef batchInputs, Eigen::Ref<const Vec> batchTarget);
+
+  };
+
+}//end namespace NN
+#endif //RECURSIVE_LEAST_SQUARES_HPP
@@ -0,0 +1,82 @@
+#ifndef TAO_TRAINER_HPP
+#define TAO_TRAINER_HPP
+
+#include "Network.hpp"
+#include <Eigen/Core>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace NN
+{
+
+  struct TaoOptions
+  {
+    //any TAO type name, e.g. "blmvm", "lmvm", "nls", "bncg"; -tao_type overrides it
+    std::string type = "blmvm";
+
+    //absolute and relative gradient tolerances
+    double gatol = 1.0e-5;
+
+    double grtol = 0.0;
+
+    int_t maxIter = 1000;
+
+    //print TAO's per-iteration monitor
+    bool monitor = false;
+
+    //also apply -tao_* command line options
+    bool fromOptions = true;
+  };
+
+
+  /*
+   * trains a Network with a PETSc TAO solver. the network's loss and flat gradient
+   * (Network::lossAndGradient) are the TAO objective/gradient callback, evaluated directly
+   * on the arrays of the PETSc Vecs TAO passes in; the solution Vec wraps the trainer's flat
+   * weight buffer. Newton-type solvers ("nls", "ntr", ...) get a matrix-free Hessian.
+   *
+   * when the library is built without PETSc (NN_HAVE_PETSC undefined), train() falls back
+   * to the built-in LBFGSTrainer with the same tolerances.
+   * */
+  class TaoTrainer
+  {
+
+  protected:
+
+    TaoOptions opts;
+
+    Vec params;
+
+    std::vector<double> lossHistory;
+
+    std::string convergedReason;
+
+  public:
+
+    TaoTrainer(const TaoOptions& _opts=TaoOptions()) :
+      opts(_opts)
+    {};
+
+    static bool havePetsc() noexcept;
+
+    auto getLossHistory() const
+    {
+      return lossHistory;
+    }
+
+    auto getConvergedReason() const
+    {
+      return convergedReason;
+    }
+
+    //returns true if TAO reports convergence
+    bool train(Network& net,
+	       std::optional<Mat> inputData=std::nullopt,
+	       std::optional<Vec> target=std::nullopt,
+	       bool noprint=false);
+
+  };
+
+}//end namespace NN
+#endif //TAO_TRAINER_HPP
@@ -0,0 +1,188 @@
+#include <AttentionLayer.hpp>
+#include <algorithm>
+#include <limits>
+
+
+namespace NN
+{
+
+  //sets entries of a score tile whose key index is past its query index to -inf
+  static void applyCausalMask(MatRef S, int_t rowStart, int_t colStart)
+  {
+    constexpr double ninf = -std::numeric_limits<double>::infinity();
+    for(int_t r = 0; r < S.rows(); r++){
+      int_t firstMasked = std::max<int_t>(rowStart + r + 1 - colStart, 0);
+      for(int_t c = firstMasked; c < S.cols(); c++){
+	S(r, c) = ninf;
+      }
+    }
+  }
+
+  void AttentionLayer::setWeights(const Mat& _Wq, const Mat& _Wk,
+				  const Mat& _Wv, const Mat& _Wo)
+  {
+    for(const Mat* W : {&_Wq, &_Wk, &_Wv, &_Wo}){
+      if(W->rows() != model_dim + 1 or W->cols() != model_dim){
+	throw "Error: attention weights must be (model_dim+1) x model_dim.";
+      }
+    }
+    Wq = _Wq;
+    Wk = _Wk;
+    Wv = _Wv;
+    Wo = _Wo;
+  }
+
+  void AttentionLayer::headForward(int_t h)
+  {
+    constexpr double ninf = -std::numeric_limits<double>::infinity();
+    const int_t N = Q.rows();
+    const int_t c0 = h * head_dim;
+    auto Qh = Q.middleCols(c0, head_dim);
+    auto Kh = K.middleCols(c0, head_dim);
+    auto Vh = V.middleCols(c0, head_dim);
+
+    Mat S, Oi;
+    Vec m, l, rowMax, mNew, alpha;
+    for(int_t i0 = 0; i0 < N; i0 += block_size){
+      const int_t bi = std::min(block_size, N - i0);
+      //with a causal mask, keys past the last query of this tile never contribute
+      const int_t jEnd = causal ? i0 + bi : N;
+
+      Oi = Mat::Zero(bi, head_dim);
+      m = Vec::Constant(bi, ninf);
+      l = Vec::Zero(bi);
+
+      for(int_t j0 = 0; j0 < jEnd; j0 += block_size){
+	const int_t bj = std::min(block_size, jEnd - j0);
+	S.noalias() = scale * Qh.middleRows(i0, bi) * Kh.middleRows(j0, bj).transpose();
+	if(causal and j0 + bj > i0){
+	  applyCausalMask(S, i0, j0);
+	}
+	//online softmax: rescale the running sum and output by exp(m_old - m_new)
+	rowMax = S.rowwise().maxCoeff();
+	mNew = m.cwiseMax(rowMax);
+	alpha = (m - mNew).array().exp();
+	S.array().colwise() -= mNew.array();
+	S = S.array().exp();
+
+	l = alpha.cwiseProduct(l) + S.rowwise().sum();
+	Oi = alpha.asDiagonal() * Oi;
+	Oi.noalias() += S * Vh.middleRows(j0, bj);
+	m = mNew;
+      }
+      attn.block(i0, c0, bi, head_dim) = l.cwiseInverse().asDiagonal() * Oi;
+      logSumExp.col(h).segment(i0, bi) = m.array() + l.array().log();
+    }
+  }
+
+  void AttentionLayer::forwardPass(ConstMatRef inputData)
+  {
+    if(inputData.cols() != model_dim){
+      throw "Error: attention input must have model_dim columns.";
+    }
+    inputs = inputData;
+    inputMat = Layer::makeInputMat(inputs);
+
+    Q.noalias() = inputMat * Wq;
+    K.noalias() = inputMat * Wk;
+    V.noalias() = inputMat * Wv;
+
+    const int_t N = inputs.rows();
+    attn.resize(N, model_dim);
+    logSumExp.resize(N, num_heads);
+
+    //heads write disjoint column blocks of attn
+    #pragma omp parallel for
+    for(int_t h = 0; h < num_heads; h++){
+      headForward(h);
+    }
+
+    attnMat = Layer::makeInputMat(attn);
+    outputs.noalias() = attnMat * Wo;
+  }
+
+  void AttentionLayer::headBackward(int_t h, ConstMatRef dAttn,
+				    MatRef dQ, MatRef dK, MatRef dV) const
+  {
+    const int_t N = Q.rows();
+    const int_t c0 = h * head_dim;
+    auto Qh = Q.middleCols(c0, head_dim);
+    auto Kh = K.middleCols(c0, head_dim);
+    auto Vh = V.middleCols(c0, head_dim);
+    auto Oh = attn.middleCols(c0, head_dim);
+    auto dOh = dAttn.middleCols(c0, head_dim);
+
+    //D_i = sum_j P_ij dP_ij = dO_i . O_i
+    Vec D = dOh.cwiseProduct(Oh).rowwise().sum();
+
+    Mat S, dP, dKj, dVj;
+    for(int_t j0 = 0; j0 < N; j0 += block_size){
+      const int_t bj = std::min(block_size, N - j0);
+      dKj = Mat::Zero(bj, head_dim);
+      dVj = Mat::Zero(bj, head_dim);
+
+      //with a causal mask, queries before the first key of this tile never see it
+      const int_t iStart = causal ? j0 : 0;
+      for(int_t i0 = iStart; i0 < N; i0 += block_size){
+	const int_t bi = std::min(block_size, N - i0);
+
+	//recompute the probability tile from the saved log-sum-exp
+	S.noalias() = scale * Qh.middleRows(i0, bi) * Kh.middleRows(j0, bj).transpose();
+	if(causal and j0 + bj > i0){
+	  applyCausalMask(S, i0, j0);
+	}
+	S.array().colwise() -= logSumExp.col(h).segment(i0, bi).array();
+	S = S.array().exp();
+
+	dVj.noalias() += S.transpose() * dOh.middleRows(i0, bi);
+
+	dP.noalias() = dOh.middleRows(i0, bi) * Vh.middleRows(j0, bj).transpose();
+	dP.array().colwise() -= D.segment(i0, bi).array();
+	//dP now holds dS / scale
+	dP = dP.cwiseProduct(S);
+
+	dQ.block(i0, c0, bi, head_dim).noalias() += scale * dP * Kh.middleRows(j0, bj);
+	dKj.noalias() += scale * dP.transpose() * Qh.middleRows(i0, bi);
+      }
+      dK.block(j0, c0, bj, head_dim) = dKj;
+      dV.block(j0, c0, bj, head_dim) = dVj;
+    }
+  }
+
+  void AttentionLayer::backwardPass(ConstMatRef loss_grad)
+  {
+    if(loss_grad.rows() != outputs.rows() or loss_grad.cols() != model_dim){
+      throw "Error: loss_grad must have the shape of the layer outputs.";
+    }
+    const int_t N = inputs.rows();
+
+    gradWo.noalias() = attnMat.transpose() * loss_grad;
+    Mat dAttn = loss_grad * Wo.topRows(model_dim).transpose();
+
+    Mat dQ = Mat::Zero(N, model_dim);
+    Mat dK(N, model_dim);
+    Mat dV(N, model_dim);
+
+    #pragma omp parallel for
+    for(int_t h = 0; h < num_heads; h++){
+      headBackward(h, dAttn, dQ, dK, dV);
+    }
+
+    gradWq.noalias() = inputMat.transpose() * dQ;
+    gradWk.noalias() = inputMat.transpose() * dK;
+    gradWv.noalias() = inputMat.transpose() * dV;
+
+    inputGrad.noalias() = dQ * Wq.topRows(model_dim).transpose();
+    inputGrad.noalias() += dK * Wk.topRows(model_dim).transpose();
+    inputGrad.noalias() += dV * Wv.topRows(model_dim).transpose();
+  }
+
+  void AttentionLayer::updateWeights()
+  {
+    applyUpdate(update, optParams, Wq.data(), gradWq.data(), stateWq, Wq.size());
+    applyUpdate(update, optParams, Wk.data(), gradWk.data(), stateWk, Wk.size());
+    applyUpdate(update, optParams, Wv.data(), gradWv.data(), stateWv, Wv.size());
+    applyUpdate(update, optParams, Wo.data(), gradWo.data(), stateWo, Wo.size());
+  }
+
+}//end namespace NN
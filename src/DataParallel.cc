@@ -0,0 +1,157 @@
+#include <DataParallel.hpp>
+
+
+namespace NN
+{
+
+  void DataParallelTrainer::Barrier::wait()
+  {
+    std::unique_lock<std::mutex> lock(mtx);
+    const size_t gen = generation;
+    if(++waiting == count){
+      waiting = 0;
+      generation++;
+      cv.notify_all();
+    } else {
+      cv.wait(lock, [this, gen]() { return generation != gen; });
+    }
+  }
+
+  DataParallelTrainer::DataParallelTrainer(int _numThreads) :
+    numThreads(std::max(1, _numThreads)),
+    barrier(std::max(1, _numThreads))
+  {
+    for(int id = 1; id < numThreads; id++){
+      pool.emplace_back(&DataParallelTrainer::poolLoop, this, id);
+    }
+  }
+
+  DataParallelTrainer::~DataParallelTrainer()
+  {
+    stopping = true;
+    barrier.wait();
+    for(auto& th : pool){
+      th.join();
+    }
+  }
+
+  void DataParallelTrainer::poolLoop(int id)
+  {
+    while(true){
+      barrier.wait();
+      if(stopping){
+	return;
+      }
+      work(id);
+      barrier.wait();
+    }
+  }
+
+  void DataParallelTrainer::work(int id)
+  {
+    const int_t n = stepInputs->rows();
+    const int_t begin = n * id / numThreads, end = n * (id + 1) / numThreads;
+    Network& replica = replicas[id];
+    auto& g = grads[id];
+    //an exception must not leave the other workers waiting at the barriers below
+    try {
+      replica.setFlatWeights(stepWeights);
+      if(end > begin){
+	replica.setBatch(stepInputs->middleRows(begin, end - begin),
+			 stepTarget->segment(begin, end - begin));
+	replica.predict();
+	replica.backwardPass();
+	size_t l = 0;
+	for(const auto& layer : replica.getLayersRef()){
+	  g[l] = layer.getGradient();
+	  l++;
+	}
+	losses[id] = replica.getScalarLoss();
+      } else {
+	size_t l = 0;
+	for(const auto& layer : replica.getLayersRef()){
+	  g[l] = Mat::Zero(layer.getInputShape().second + 1, layer.getOutputSize());
+	  l++;
+	}
+	losses[id] = 0.0;
+      }
+    } catch(...) {
+      errors[id] = std::current_exception();
+    }
+
+    //pairwise tree: after the level with stride s, worker t (t % 2s == 0) holds slices t..t+2s-1.
+    //every worker has finished its slice by the first level's barrier, so all see the same errors
+    for(int s = 1; s < numThreads; s *= 2){
+      barrier.wait();
+      bool failed = false;
+      for(const auto& e : errors){
+	failed = failed or e;
+      }
+      if(not failed and id % (2 * s) == 0 and id + s < numThreads){
+	for(size_t l = 0; l < g.size(); l++){
+	  g[l] += grads[id + s][l];
+	}
+      }
+    }
+  }
+
+  //same network, same layer shapes and activations: the replicas' configuration is still good
+  bool DataParallelTrainer::replicasMatch(Network& net)
+  {
+    if(replicas.size() != static_cast<size_t>(numThreads) or replicaSource != &net
+       or replicas.front().numParams() != net.numParams()
+       or replicas.front().getLayersRef().size() != net.getLayersRef().size()){
+      return false;
+    }
+    auto r = replicas.front().getLayersRef().begin();
+    for(const auto& l : net.getLayersRef()){
+      if(r->getInputShape().second != l.getInputShape().second or r->getOutputSize() != l.getOutputSize()
+	 or r->getActivationName() != l.getActivationName()){
+	return false;
+      }
+      r++;
+    }
+    return true;
+  }
+
+  double DataParallelTrainer::step(Network& net, const Mat& batchInputs, const Vec& batchTarget)
+  {
+    if(batchTarget.size() != batchInputs.rows()){
+      throw "Error: need one target per batch row.";
+    }
+    auto& layers = net.getLayersRef();
+    if(not replicasMatch(net)){
+      replicas.assign(numThreads, net);
+      replicaSource = &net;
+      grads.assign(numThreads, std::vector<Mat>(layers.size()));
+      losses.assign(numThreads, 0.0);
+    }
+    errors.assign(numThreads, nullptr);
+    stepInputs = &batchInputs;
+    stepTarget = &batchTarget;
+    stepWeights = net.getFlatWeights();
+
+    barrier.wait();
+    work(0);
+    barrier.wait();
+    for(const auto& e : errors){
+      if(e){
+	std::rethrow_exception(e);
+      }
+    }
+
+    size_t l = 0;
+    for(auto& layer : layers){
+      layer.setGradient(grads[0][l]);
+      l++;
+    }
+    net.updateWeights();
+
+    double loss = 0.0;
+    for(double lt : losses){
+      loss += lt;
+    }
+    return loss;
+  }
+
+}//end namespace NN
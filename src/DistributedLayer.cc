@@ -0,0 +1,236 @@
+#include <DistributedLayer.hpp>
+
+#ifdef NN_HAVE_PETSC
+
+#if defined(PETSC_USE_COMPLEX)
+#error "DistributedLayer needs a real-valued PETSc build"
+#endif
+#include <random>
+#include <vector>
+
+
+namespace NN
+{
+
+  namespace
+  {
+    using ColMat = Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::ColMajor>;
+
+    //a dense PETSc matrix's local rows: all its columns, column-major with leading dimension lda
+    Eigen::Map<ColMat, 0, Eigen::OuterStride<>> localBlock(PetscScalar* a, PetscInt rows, PetscInt cols, PetscInt lda)
+    {
+      return Eigen::Map<ColMat, 0, Eigen::OuterStride<>>(a, rows, cols, Eigen::OuterStride<>(lda));
+    }
+
+    Eigen::Map<const ColMat, 0, Eigen::OuterStride<>> localBlock(const PetscScalar* a, PetscInt rows, PetscInt cols, PetscInt lda)
+    {
+      return Eigen::Map<const ColMat, 0, Eigen::OuterStride<>>(a, rows, cols, Eigen::OuterStride<>(lda));
+    }
+  }
+
+  DistributedLayer::DistributedLayer(MPI_Comm _comm, int_t _input_size, int_t _output_size,
+				     std::string _activation, unsigned seed) :
+    comm(_comm),
+    input_size(_input_size),
+    output_size(_output_size)
+  {
+    if(input_size <= 0 or output_size <= 0){
+      throw "Error: input and output sizes must be positive.";
+    }
+    setActivation(_activation);
+    PetscCallAbort(comm, MatCreateDense(comm, PETSC_DECIDE, PETSC_DECIDE, input_size + 1, output_size,
+					NULL, &weights));
+    PetscInt hi;
+    PetscCallAbort(comm, MatGetOwnershipRange(weights, &firstRow, &hi));
+    localRows = hi - firstRow;
+
+    PetscScalar* w;
+    PetscInt lda;
+    PetscCallAbort(comm, MatDenseGetLDA(weights, &lda));
+    PetscCallAbort(comm, MatDenseGetArrayWrite(weights, &w));
+    auto W = localBlock(w, localRows, output_size, lda);
+    std::uniform_real_distribution<double> uniform(-1.0, 1.0);
+    for(PetscInt r = 0; r < localRows; r++){
+      std::mt19937_64 gen(seed + firstRow + r);
+      for(int_t c = 0; c < output_size; c++){
+	W(r, c) = uniform(gen);
+      }
+    }
+    PetscCallAbort(comm, MatDenseRestoreArrayWrite(weights, &w));
+    PetscCallAbort(comm, MatAssemblyBegin(weights, MAT_FINAL_ASSEMBLY));
+    PetscCallAbort(comm, MatAssemblyEnd(weights, MAT_FINAL_ASSEMBLY));
+  }
+
+  DistributedLayer::~DistributedLayer()
+  {
+    destroyActivations();
+    MatDestroy(&weights);
+  }
+
+  void DistributedLayer::destroyActivations()
+  {
+    //the products remember their factors, so they go with them
+    MatDestroy(&inputMat);
+    MatDestroy(&errMat);
+    MatDestroy(&actMat);
+    MatDestroy(&inputGradMat);
+    MatDestroy(&gradient);
+    localBatch = -1;
+  }
+
+  void DistributedLayer::setActivation(std::string actName)
+  {
+    if(ACTIVATIONS.count(actName) == 0){
+      throw "Error: unknown activation.";
+    }
+    activation = ACTIVATIONS[actName];
+    activation_grad = ACTIVATION_DERIVATIVES[actName];
+    activationName = actName;
+  }
+
+  void DistributedLayer::setOptimizer(UpdateRule rule, const OptimizerParams& params)
+  {
+    if(rule == UpdateRule::LARS or rule == UpdateRule::LAMB){
+      throw "Error: the weights are split across ranks; LARS and LAMB need whole layers.";
+    }
+    //each rank's rows are stored column-major, so the bias row is not a contiguous tail
+    if(params.l2 > 0.0 or params.decoupledDecay > 0.0 or params.l1 > 0.0 or params.maxNorm > 0.0){
+      throw "Error: the regularizers are not supported on weights split across ranks.";
+    }
+    if(rule != update){
+      optState.reset();
+    }
+    update = rule;
+    optParams = params;
+  }
+
+  Mat DistributedLayer::getWeights() const
+  {
+    const PetscScalar* w;
+    PetscInt lda;
+    PetscCallAbort(comm, MatDenseGetLDA(weights, &lda));
+    PetscCallAbort(comm, MatDenseGetArrayRead(weights, &w));
+    Mat local = localBlock(w, localRows, output_size, lda);
+    PetscCallAbort(comm, MatDenseRestoreArrayRead(weights, &w));
+
+    const PetscInt* ranges;
+    int size;
+    MPI_Comm_size(comm, &size);
+    PetscCallAbort(comm, MatGetOwnershipRanges(weights, &ranges));
+    std::vector<int> counts(size), displs(size);
+    for(int r = 0; r < size; r++){
+      counts[r] = (ranges[r + 1] - ranges[r]) * output_size;
+      displs[r] = ranges[r] * output_size;
+    }
+    Mat full(input_size + 1, output_size);
+    MPI_Allgatherv(local.data(), local.size(), MPI_DOUBLE, full.data(), counts.data(), displs.data(),
+		   MPI_DOUBLE, comm);
+    return full;
+  }
+
+  void DistributedLayer::setWeights(ConstMatRef _weights)
+  {
+    if(_weights.rows() != input_size + 1 or _weights.cols() != output_size){
+      throw "Error: weights must be (input size + 1) x output size.";
+    }
+    PetscScalar* w;
+    PetscInt lda;
+    PetscCallAbort(comm, MatDenseGetLDA(weights, &lda));
+    PetscCallAbort(comm, MatDenseGetArrayWrite(weights, &w));
+    localBlock(w, localRows, output_size, lda) = _weights.middleRows(firstRow, localRows);
+    PetscCallAbort(comm, MatDenseRestoreArrayWrite(weights, &w));
+  }
+
+  void DistributedLayer::forwardPass(ConstMatRef inputs)
+  {
+    if(inputs.cols() != input_size){
+      throw "Error: inputs must have input size columns.";
+    }
+    const PetscInt m = inputs.rows();
+    //creating the matrices is collective, so every rank remakes them if any rank's batch changed
+    int changed = m != localBatch;
+    MPI_Allreduce(MPI_IN_PLACE, &changed, 1, MPI_INT, MPI_LOR, comm);
+    if(changed){
+      destroyActivations();
+      //[inputs, 1]'s columns are split like the weights' rows, as the product needs
+      PetscCallAbort(comm, MatCreateDense(comm, m, localRows, PETSC_DETERMINE, input_size + 1, NULL, &inputMat));
+      PetscCallAbort(comm, MatCreateDense(comm, m, PETSC_DECIDE, PETSC_DETERMINE, output_size, NULL, &errMat));
+      localBatch = m;
+    }
+
+    PetscScalar* x;
+    PetscInt lda;
+    PetscCallAbort(comm, MatDenseGetLDA(inputMat, &lda));
+    PetscCallAbort(comm, MatDenseGetArrayWrite(inputMat, &x));
+    auto X = localBlock(x, m, input_size + 1, lda);
+    X.leftCols(input_size) = inputs;
+    X.col(input_size).setOnes();
+    PetscCallAbort(comm, MatDenseRestoreArrayWrite(inputMat, &x));
+    PetscCallAbort(comm, MatAssemblyBegin(inputMat, MAT_FINAL_ASSEMBLY));
+    PetscCallAbort(comm, MatAssemblyEnd(inputMat, MAT_FINAL_ASSEMBLY));
+
+    PetscCallAbort(comm, MatMatMult(inputMat, weights, actMat ? MAT_REUSE_MATRIX : MAT_INITIAL_MATRIX,
+				    PETSC_DEFAULT, &actMat));
+    const PetscScalar* a;
+    PetscCallAbort(comm, MatDenseGetLDA(actMat, &lda));
+    PetscCallAbort(comm, MatDenseGetArrayRead(actMat, &a));
+    actVals = localBlock(a, m, output_size, lda);
+    PetscCallAbort(comm, MatDenseRestoreArrayRead(actMat, &a));
+    outputs = actVals.unaryExpr(activation);
+  }
+
+  void DistributedLayer::backwardPass(ConstMatRef loss_grad)
+  {
+    if(localBatch < 0 or loss_grad.rows() != localBatch or loss_grad.cols() != output_size){
+      throw "Error: loss gradient must match the outputs of the last forwardPass.";
+    }
+    err = loss_grad.cwiseProduct(activation_grad(std::make_pair(actVals, outputs)));
+
+    PetscScalar* e;
+    PetscInt lda;
+    PetscCallAbort(comm, MatDenseGetLDA(errMat, &lda));
+    PetscCallAbort(comm, MatDenseGetArrayWrite(errMat, &e));
+    localBlock(e, localBatch, output_size, lda) = err;
+    PetscCallAbort(comm, MatDenseRestoreArrayWrite(errMat, &e));
+    PetscCallAbort(comm, MatAssemblyBegin(errMat, MAT_FINAL_ASSEMBLY));
+    PetscCallAbort(comm, MatAssemblyEnd(errMat, MAT_FINAL_ASSEMBLY));
+
+    //[inputs, 1]^T err over every rank's rows: its rows are split like the weights'
+    PetscCallAbort(comm, MatTransposeMatMult(inputMat, errMat, gradient ? MAT_REUSE_MATRIX : MAT_INITIAL_MATRIX,
+					     PETSC_DEFAULT, &gradient));
+    PetscCallAbort(comm, MatMatTransposeMult(errMat, weights, inputGradMat ? MAT_REUSE_MATRIX : MAT_INITIAL_MATRIX,
+					     PETSC_DEFAULT, &inputGradMat));
+    const PetscScalar* g;
+    PetscCallAbort(comm, MatDenseGetLDA(inputGradMat, &lda));
+    PetscCallAbort(comm, MatDenseGetArrayRead(inputGradMat, &g));
+    //the bias column does not depend on the inputs
+    inputGrad = localBlock(g, localBatch, input_size + 1, lda).leftCols(input_size);
+    PetscCallAbort(comm, MatDenseRestoreArrayRead(inputGradMat, &g));
+  }
+
+  void DistributedLayer::updateWeights()
+  {
+    if(gradient == nullptr){
+      throw "Error: no gradient; run backwardPass first.";
+    }
+    PetscInt gLo, gHi, wLda, gLda;
+    PetscCallAbort(comm, MatGetOwnershipRange(gradient, &gLo, &gHi));
+    PetscCallAbort(comm, MatDenseGetLDA(weights, &wLda));
+    PetscCallAbort(comm, MatDenseGetLDA(gradient, &gLda));
+    if(gLo != firstRow or gHi != firstRow + localRows
+       or (localRows > 0 and (wLda != localRows or gLda != localRows))){
+      throw "Error: gradient and weights are not laid out alike.";
+    }
+    PetscScalar* w;
+    const PetscScalar* g;
+    PetscCallAbort(comm, MatDenseGetArray(weights, &w));
+    PetscCallAbort(comm, MatDenseGetArrayRead(gradient, &g));
+    //elementwise rules do not care about the column-major order
+    applyUpdate(update, optParams, w, g, optState, numLocalParams());
+    PetscCallAbort(comm, MatDenseRestoreArrayRead(gradient, &g));
+    PetscCallAbort(comm, MatDenseRestoreArray(weights, &w));
+  }
+
+}//end namespace NN
+
+#endif //NN_HAVE_PETSC
@@ -0,0 +1,102 @@
+#include <EmbeddingLayer.hpp>
+#include <algorithm>
+#include <cmath>
+
+
+namespace NN
+{
+
+  void EmbeddingLayer::setWeights(const Mat& _weights)
+  {
+    if(_weights.rows() != vocab_size or _weights.cols() != embedding_dim){
+      throw "Error: embedding weights must be vocab_size x embedding_dim.";
+    }
+    weights = _weights;
+    weightUpdate.setZero();
+    std::fill(lastStep.begin(), lastStep.end(), step);
+  }
+
+  void EmbeddingLayer::catchUpRow(int_t row)
+  {
+    const int_t k = step - lastStep[row];
+    if(k == 0){
+      return;
+    }
+    lastStep[row] = step;
+    const double momentum = std::get<1>(updateParams);
+    //k updates with zero gradient: v <- mu v, w <- w + v, applied in closed form (mu = 0
+    //still clears v)
+    const double muk = std::pow(momentum, static_cast<double>(k));
+    const double drift = momentum == 1.0 ? static_cast<double>(k) : momentum * (1.0 - muk) / (1.0 - momentum);
+    weights.row(row) += drift * weightUpdate.row(row);
+    weightUpdate.row(row) *= muk;
+  }
+
+  void EmbeddingLayer::synchronizeWeights()
+  {
+    for(int_t r = 0; r < vocab_size; r++){
+      catchUpRow(r);
+    }
+  }
+
+  void EmbeddingLayer::forwardPass(const IdMat& inputIds)
+  {
+    if(inputIds.size() > 0 and (inputIds.minCoeff() < 0 or inputIds.maxCoeff() >= vocab_size)){
+      throw "Error: embedding id out of range.";
+    }
+    ids = inputIds;
+    num_fields = ids.cols();
+    outputs.resize(ids.rows(), num_fields * embedding_dim);
+    for(int_t i = 0; i < ids.rows(); i++){
+      for(int_t f = 0; f < num_fields; f++){
+	const int_t row = ids(i, f);
+	catchUpRow(row);
+	outputs.block(i, f * embedding_dim, 1, embedding_dim) = weights.row(row);
+      }
+    }
+  }
+
+  void EmbeddingLayer::backwardPass(ConstMatRef loss_grad)
+  {
+    if(loss_grad.rows() != ids.rows() or loss_grad.cols() != num_fields * embedding_dim){
+      throw "Error: loss_grad must have the shape of the layer outputs.";
+    }
+    gradient.rows.clear();
+    for(int_t i = 0; i < ids.rows(); i++){
+      for(int_t f = 0; f < num_fields; f++){
+	const int_t row = ids(i, f);
+	if(rowSlot[row] < 0){
+	  rowSlot[row] = gradient.rows.size();
+	  gradient.rows.push_back(row);
+	}
+      }
+    }
+
+    //scatter-add into one gradient row per distinct id
+    gradient.values = Mat::Zero(gradient.rows.size(), embedding_dim);
+    for(int_t i = 0; i < ids.rows(); i++){
+      for(int_t f = 0; f < num_fields; f++){
+	gradient.values.row(rowSlot[ids(i, f)]) += loss_grad.block(i, f * embedding_dim, 1, embedding_dim);
+      }
+    }
+
+    for(auto row : gradient.rows){
+      rowSlot[row] = -1;
+    }
+  }
+
+  void EmbeddingLayer::updateWeights()
+  {
+    auto [learningRate, momentum] = updateParams;
+
+    for(size_t k = 0; k < gradient.rows.size(); k++){
+      const int_t row = gradient.rows[k];
+      catchUpRow(row);
+      weightUpdate.row(row) = momentum * weightUpdate.row(row) - learningRate * gradient.values.row(k);
+      weights.row(row) += weightUpdate.row(row);
+      lastStep[row] = step + 1;
+    }
+    step++;
+  }
+
+}//end namespace NN
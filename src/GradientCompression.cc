@@ -0,0 +1,183 @@
+#include <GradientCompression.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <numeric>
+#include <random>
+
+
+namespace NN
+{
+
+  Mat& GradientCompressor::accumulate(size_t layer, ConstMatRef grad)
+  {
+    if(residual.size() <= layer){
+      residual.resize(layer + 1);
+    }
+    Mat& M = residual[layer];
+    if(not opts.errorFeedback or M.rows() != grad.rows() or M.cols() != grad.cols()){
+      M = grad;
+    } else {
+      M += grad;
+    }
+    return M;
+  }
+
+  int_t GradientCompressor::topK(int_t n) const noexcept
+  {
+    return std::clamp(static_cast<int_t>(std::ceil(opts.topKRatio * n)), int_t(1), n);
+  }
+
+  size_t GradientCompressor::payloadBytes(int_t rows, int_t cols) const noexcept
+  {
+    const int_t n = rows * cols;
+    switch(opts.method){
+    case Compression::TopK:
+      return topK(n) * (sizeof(std::int32_t) + sizeof(float));
+    case Compression::Int8:
+      return sizeof(float) + n;
+    case Compression::Sign:
+      return sizeof(float) + (n + 7) / 8;
+    default:
+      return n * sizeof(double);
+    }
+  }
+
+  void GradientCompressor::encode(size_t layer, ConstMatRef grad, unsigned char* payload)
+  {
+    Mat& M = accumulate(layer, grad);
+    const int_t n = M.size();
+    double* m = M.data();
+    bytesSent += payloadBytes(M.rows(), M.cols());
+    bytesDense += n * sizeof(double);
+
+    //each case leaves in m what the payload does not carry
+    switch(opts.method){
+    case Compression::TopK: {
+      const int_t k = topK(n);
+      std::vector<std::int32_t> idx(n);
+      std::iota(idx.begin(), idx.end(), 0);
+      std::nth_element(idx.begin(), idx.begin() + (k - 1), idx.end(), [m](std::int32_t a, std::int32_t b) {
+	  return std::abs(m[a]) > std::abs(m[b]);
+	});
+      //ascending indices, so equal inputs give byte-identical payloads
+      std::sort(idx.begin(), idx.begin() + k);
+      for(int_t j = 0; j < k; j++){
+	const float v = static_cast<float>(m[idx[j]]);
+	std::memcpy(payload + j * 8, &idx[j], 4);
+	std::memcpy(payload + j * 8 + 4, &v, 4);
+	m[idx[j]] -= v;
+      }
+      break;
+    }
+    case Compression::Int8: {
+      const float scale = static_cast<float>(M.cwiseAbs().maxCoeff() / 127.0);
+      std::memcpy(payload, &scale, sizeof(float));
+      auto* q = reinterpret_cast<std::int8_t*>(payload + sizeof(float));
+      for(int_t i = 0; i < n; i++){
+	const double r = scale > 0.0f ? std::round(m[i] / scale) : 0.0;
+	q[i] = static_cast<std::int8_t>(std::clamp(r, -127.0, 127.0));
+	m[i] -= q[i] * static_cast<double>(scale);
+      }
+      break;
+    }
+    case Compression::Sign: {
+      const float scale = static_cast<float>(M.cwiseAbs().mean());
+      std::memcpy(payload, &scale, sizeof(float));
+      unsigned char* bits = payload + sizeof(float);
+      std::fill(bits, bits + (n + 7) / 8, 0);
+      for(int_t i = 0; i < n; i++){
+	if(m[i] >= 0.0){
+	  bits[i / 8] |= 1 << (i % 8);
+	  m[i] -= scale;
+	} else {
+	  m[i] += scale;
+	}
+      }
+      break;
+    }
+    default:
+      std::memcpy(payload, m, n * sizeof(double));
+      M.setZero();
+    }
+  }
+
+  void GradientCompressor::decodeAdd(const unsigned char* payload, MatRef sum) const
+  {
+    const int_t n = sum.size();
+    double* s = sum.data();
+    switch(opts.method){
+    case Compression::TopK:
+      for(int_t j = 0; j < topK(n); j++){
+	std::int32_t i;
+	float v;
+	std::memcpy(&i, payload + j * 8, 4);
+	std::memcpy(&v, payload + j * 8 + 4, 4);
+	s[i] += v;
+      }
+      break;
+    case Compression::Int8: {
+      float scale;
+      std::memcpy(&scale, payload, sizeof(float));
+      const auto* q = reinterpret_cast<const std::int8_t*>(payload + sizeof(float));
+      for(int_t i = 0; i < n; i++){
+	s[i] += q[i] * static_cast<double>(scale);
+      }
+      break;
+    }
+    case Compression::Sign: {
+      float scale;
+      std::memcpy(&scale, payload, sizeof(float));
+      const unsigned char* bits = payload + sizeof(float);
+      for(int_t i = 0; i < n; i++){
+	s[i] += (bits[i / 8] >> (i % 8)) & 1 ? scale : -scale;
+      }
+      break;
+    }
+    default:
+      for(int_t i = 0; i < n; i++){
+	double v;
+	std::memcpy(&v, payload + i * sizeof(double), sizeof(double));
+	s[i] += v;
+      }
+    }
+  }
+
+  void GradientCompressor::lowRankP(size_t layer, ConstMatRef grad, MatRef P)
+  {
+    const Mat& M = accumulate(layer, grad);
+    if(powerQ.size() <= layer){
+      powerQ.resize(layer + 1);
+    }
+    Mat& Q = powerQ[layer];
+    if(Q.rows() != M.cols() or Q.cols() != opts.rank){
+      //the same seed on every worker gives every worker the same Q
+      std::mt19937_64 gen(opts.seed + layer);
+      std::normal_distribution<double> normal;
+      Q.resize(M.cols(), opts.rank);
+      for(int_t i = 0; i < Q.size(); i++){
+	Q.data()[i] = normal(gen);
+      }
+    }
+    P.noalias() = M * Q;
+    //P now, Q in the second sum
+    bytesSent += (P.size() + Q.size()) * sizeof(double);
+    bytesDense += M.size() * sizeof(double);
+  }
+
+  void GradientCompressor::lowRankQ(size_t layer, MatRef P, MatRef Q) const
+  {
+    Eigen::HouseholderQR<Mat> qr(P);
+    P = qr.householderQ() * Mat::Identity(P.rows(), P.cols());
+    Q.noalias() = residual[layer].transpose() * P;
+  }
+
+  void GradientCompressor::lowRankFinish(size_t layer, ConstMatRef P, ConstMatRef Q, int numWorkers, MatRef sum)
+  {
+    sum.noalias() = P * Q.transpose();
+    residual[layer] -= sum / numWorkers;
+    powerQ[layer] = Q;
+  }
+
+}//end namespace NN
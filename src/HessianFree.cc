@@ -0,0 +1,125 @@
+#include <HessianFree.hpp>
+#include <algorithm>
+#include <cmath>
+
+
+namespace NN
+{
+
+  double NewtonCGTrainer::truncatedCG(Network& net, const Vec& g, Vec& d)
+  {
+    auto applyA = [&](const Vec& v) -> Vec {
+      numHessianProducts++;
+      return net.hessianVectorProduct(v, opts.gaussNewton) + lambda * v;
+    };
+
+    //r = -g - A d; a warm start that does not decrease the model is dropped
+    Vec r = -g;
+    if(d.squaredNorm() > 0.0){
+      Vec r0 = -g - applyA(d);
+      if(g.dot(d) + 0.5 * d.dot(-g - r0) < 0.0){
+	r = r0;
+      } else {
+	d.setZero();
+      }
+    }
+
+    const double gnorm = g.norm();
+    const double tol = std::min(0.5, std::sqrt(gnorm)) * gnorm;
+    Vec p = r;
+    double rr = r.squaredNorm();
+    for(int_t k = 0; k < opts.cgMaxIter and std::sqrt(rr) > tol; k++){
+      Vec Ap = applyA(p);
+      const double curv = p.dot(Ap);
+      if(curv <= 0.0){
+	//negative curvature: stop, or take the residual direction if nothing was taken yet.
+	//then d = p = r, and r is not updated, so d^T H d comes from this product instead
+	if(d.squaredNorm() == 0.0){
+	  d = r;
+	  return curv - lambda * d.squaredNorm();
+	}
+	break;
+      }
+      const double alpha = rr / curv;
+      d += alpha * p;
+      r -= alpha * Ap;
+      const double rrNew = r.squaredNorm();
+      p = r + (rrNew / rr) * p;
+      rr = rrNew;
+    }
+    //A d = -g - r, so d^T H d follows without another product
+    return d.dot(-g - r) - lambda * d.squaredNorm();
+  }
+
+  bool NewtonCGTrainer::train(Network& net,
+			      std::optional<Mat> inputData,
+			      std::optional<Vec> target,
+			      bool noprint)
+  {
+    net.predict(inputData, target);
+
+    Vec x = net.getFlatWeights();
+    Vec g(x.size()), gTrial(x.size()), xTrial(x.size());
+    double f = net.lossAndGradient(x, g);
+    lossHistory.push_back(f);
+    lambda = opts.initialDamping;
+
+    Vec d = Vec::Zero(x.size());
+    for(size_t it = 0; it < opts.maxIter; it++){
+      if(g.norm() < opts.gradTol){
+	break;
+      }
+      d *= opts.warmStartDecay;
+      double dHd = truncatedCG(net, g, d);
+      double gd = g.dot(d);
+      if(gd >= 0.0){
+	d = -g;
+	gd = -g.squaredNorm();
+	dHd = 0.0;
+      }
+      const double predicted = gd + 0.5 * dHd;
+
+      double alpha = 1.0;
+      bool accepted = false;
+      for(int_t k = 0; k < opts.maxBacktrack; k++){
+	xTrial = x + alpha * d;
+	const double fTrial = net.lossAndGradient(xTrial, gTrial);
+	if(k == 0){
+	  const double rho = predicted < 0.0 ? (fTrial - f) / predicted : 0.0;
+	  if(rho < 0.25){
+	    lambda *= 1.5;
+	  } else if(rho > 0.75){
+	    lambda = std::max(opts.minDamping, lambda * 2.0 / 3.0);
+	  }
+	}
+	if(std::isfinite(fTrial) and fTrial <= f + opts.c1 * alpha * gd){
+	  x = xTrial;
+	  g = gTrial;
+	  f = fTrial;
+	  accepted = true;
+	  break;
+	}
+	alpha *= 0.5;
+      }
+      if(not accepted){
+	//no decrease along d: more damping and a cold start
+	lambda *= 4.0;
+	d.setZero();
+	net.lossAndGradient(x, g);
+	continue;
+      }
+      d *= alpha;
+      lossHistory.push_back(f);
+    }
+
+    net.setFlatWeights(x);
+    net.predict();
+    const bool converged = g.norm() < opts.gradTol;
+    if(not converged and not noprint){
+      std::cout << "WARNING: NEWTON-CG STOPPED BEFORE REACHING THE GRADIENT TOLERANCE. SCALAR LOSS IS "
+		<< f << ". \n";
+    }
+    return converged;
+  }
+
+}//end namespace NN
@@ -0,0 +1,164 @@
+#include <Hogwild.hpp>
+#include <algorithm>
+#include <iterator>
+#include <random>
+#include <thread>
+
+
+namespace NN
+{
+
+  void HogwildTrainer::worker(int id, Network replica, ConstMatRef X, Eigen::Ref<const Vec> y,
+			      std::vector<double>& loss)
+  {
+    //an exception must not escape the thread: train() rethrows it after the join
+    try {
+      const int_t P = replica.numParams();
+      std::vector<int_t> rows;
+      for(int_t i = id; i < X.rows(); i += opts.numThreads){
+	rows.push_back(i);
+      }
+      const int_t n = rows.size();
+      std::mt19937_64 gen(opts.seed + id);
+      Mat batchInputs;
+      Vec batchTarget, w(P), g(P);
+      auto& layers = replica.getLayersRef();
+      Layer& first = layers.front();
+      const int_t cols = first.getOutputSize(), firstSize = first.numParams();
+      //the first layer's weight rows the current batch touches
+      std::vector<int_t> active;
+
+      //read-modify-write without a lock: a racing update may be lost, never torn
+      int_fast64_t writes = 0;
+      auto write = [&](int_t i) {
+	if(g[i] != 0.0){
+	  shared[i].store(shared[i].load(std::memory_order_relaxed) - opts.learningRate * g[i],
+			  std::memory_order_relaxed);
+	  writes++;
+	}
+      };
+
+      for(size_t epoch = 0; epoch < opts.epochs; epoch++){
+	std::shuffle(rows.begin(), rows.end(), gen);
+	double sum = 0.0;
+	for(int_t start = 0; start < n; start += opts.batchSize){
+	  if(aborted.load(std::memory_order_relaxed)){
+	    return;
+	  }
+	  const int_t m = std::min(opts.batchSize, n - start);
+	  batchInputs.resize(m, X.cols());
+	  batchTarget.resize(m);
+	  for(int_t j = 0; j < m; j++){
+	    batchInputs.row(j) = X.row(rows[start + j]);
+	    batchTarget[j] = y[rows[start + j]];
+	  }
+	  replica.setBatch(batchInputs, batchTarget);
+
+	  //a feature that is zero over the whole batch neither affects the outputs nor gets a
+	  //gradient, so its first-layer row is neither read nor written
+	  active.clear();
+	  for(int_t c = 0; c < X.cols(); c++){
+	    if((batchInputs.col(c).array() != 0.0).any()){
+	      active.push_back(c);
+	    }
+	  }
+	  active.push_back(first.getInputShape().second);//the bias row
+
+	  for(int_t r : active){
+	    for(int_t i = r * cols; i < (r + 1) * cols; i++){
+	      w[i] = shared[i].load(std::memory_order_relaxed);
+	    }
+	    first.setWeightRowsFrom(w.data() + r * cols, r, 1);
+	  }
+	  for(int_t i = firstSize; i < P; i++){
+	    w[i] = shared[i].load(std::memory_order_relaxed);
+	  }
+	  int_t offset = firstSize;
+	  for(auto l = std::next(layers.begin()); l != layers.end(); l++){
+	    l->setWeightsFrom(w.data() + offset);
+	    offset += l->numParams();
+	  }
+
+	  replica.predict();
+	  replica.backwardPass();
+	  sum += replica.getScalarLoss();
+
+	  writes = 0;
+	  for(int_t r : active){
+	    first.copyGradientRowsTo(g.data() + r * cols, r, 1);
+	    for(int_t i = r * cols; i < (r + 1) * cols; i++){
+	      write(i);
+	    }
+	  }
+	  offset = firstSize;
+	  for(auto l = std::next(layers.begin()); l != layers.end(); l++){
+	    l->copyGradientTo(g.data() + offset);
+	    offset += l->numParams();
+	  }
+	  for(int_t i = firstSize; i < P; i++){
+	    write(i);
+	  }
+	  numWrites.fetch_add(writes, std::memory_order_relaxed);
+	}
+	loss[epoch] = n > 0 ? sum / n : 0.0;
+      }
+    } catch(...) {
+      errors[id] = std::current_exception();
+      aborted = true;
+    }
+  }
+
+  void HogwildTrainer::train(Network& net, ConstMatRef X, Eigen::Ref<const Vec> y, bool noprint)
+  {
+    if(y.size() != X.rows()){
+      throw "Error: need one target per data row.";
+    }
+    if(opts.numThreads < 1 or opts.batchSize < 1){
+      throw "Error: need at least one thread and a positive batch size.";
+    }
+    const int_t P = net.numParams();
+    Vec w = net.getFlatWeights();
+    shared.reset(new std::atomic<double>[P]);
+    for(int_t i = 0; i < P; i++){
+      shared[i].store(w[i], std::memory_order_relaxed);
+    }
+
+    std::vector<Network> replicas(opts.numThreads, net);
+    errors.assign(opts.numThreads, nullptr);
+    aborted = false;
+    std::vector<std::vector<double>> losses(opts.numThreads, std::vector<double>(opts.epochs, 0.0));
+    std::vector<std::thread> threads;
+    for(int t = 0; t < opts.numThreads; t++){
+      threads.emplace_back([this, t, &replicas, &X, &y, &losses]() {
+	  worker(t, std::move(replicas[t]), X, y, losses[t]);
+	});
+    }
+    for(auto& th : threads){
+      th.join();
+    }
+    for(const auto& e : errors){
+      if(e){
+	std::rethrow_exception(e);
+      }
+    }
+
+    for(int_t i = 0; i < P; i++){
+      w[i] = shared[i].load(std::memory_order_relaxed);
+    }
+    net.setFlatWeights(w);
+    net.setBatch(X, y);
+    net.predict();
+
+    for(size_t epoch = 0; epoch < opts.epochs; epoch++){
+      double mean = 0.0;
+      for(const auto& l : losses){
+	mean += l[epoch];
+      }
+      epochLoss.push_back(mean / opts.numThreads);
+      if(not noprint){
+	std::cout << "epoch " << epoch + 1 << ": mean loss " << epochLoss.back() << '\n';
+      }
+    }
+  }
+
+}//end namespace NN
@@ -0,0 +1,127 @@
+#include <KFAC.hpp>
+#include <cmath>
+#include <chrono>
+
+
+namespace NN
+{
+
+  KFACOptimizer::FactorList KFACOptimizer::invertFactors(FactorList AS, double damping)
+  {
+    for(auto& [A, S] : AS){
+      //pi balances the damping between the factors by their average eigenvalues
+      const double trA = A.trace() / A.rows(), trS = S.trace() / S.rows();
+      const double pi = (trA > 0.0 and trS > 0.0) ? std::sqrt(trA / trS) : 1.0;
+      const double gamma = std::sqrt(damping);
+      A.diagonal().array() += pi * gamma;
+      S.diagonal().array() += gamma / pi;
+      A = A.selfadjointView<Eigen::Lower>().llt().solve(Mat::Identity(A.rows(), A.cols()));
+      S = S.selfadjointView<Eigen::Lower>().llt().solve(Mat::Identity(S.rows(), S.cols()));
+    }
+    return AS;
+  }
+
+  void KFACOptimizer::collectInverses(bool wait)
+  {
+    if(not pending.valid()){
+      return;
+    }
+    if(not wait and pending.wait_for(std::chrono::seconds(0)) != std::future_status::ready){
+      return;
+    }
+    FactorList inverses = pending.get();
+    for(size_t i = 0; i < factors.size(); i++){
+      factors[i].Ainv = std::move(inverses[i].first);
+      factors[i].Sinv = std::move(inverses[i].second);
+    }
+    numInversions++;
+  }
+
+  void KFACOptimizer::precondition(Network& net)
+  {
+    auto& layers = net.getLayersRef();
+    if(factors.size() != layers.size()){
+      collectInverses(true);
+      factors.assign(layers.size(), Factors());
+      lastLaunch = numSteps - opts.inversionPeriod;
+    }
+
+    if(not opts.empiricalFisher){
+      net.backwardFrom(Mat::Ones(net.getOutputs().size(), 1));
+      size_t i = 0;
+      for(const auto& l : layers){
+	l.accumulateKroneckerFactors(factors[i].A, factors[i].S, opts.decay);
+	i++;
+      }
+    }
+    net.backwardPass();
+    if(opts.empiricalFisher){
+      size_t i = 0;
+      for(const auto& l : layers){
+	l.accumulateKroneckerFactors(factors[i].A, factors[i].S, opts.decay);
+	i++;
+      }
+    }
+
+    if(numSteps - lastLaunch >= opts.inversionPeriod and not pending.valid()){
+      lastLaunch = numSteps;
+      FactorList AS;
+      for(const auto& f : factors){
+	AS.emplace_back(f.A, f.S);
+      }
+      auto policy = opts.async ? std::launch::async : std::launch::deferred;
+      pending = std::async(policy, invertFactors, std::move(AS), opts.damping);
+    }
+    //block only when there are no inverses yet or when inverting synchronously
+    collectInverses(not opts.async or factors.front().Ainv.size() == 0);
+
+    double gradSq = 0.0, quad = 0.0;
+    std::vector<Mat> nat(layers.size());
+    size_t i = 0;
+    for(auto& l : layers){
+      Mat G = l.getGradient();
+      gradSq += G.squaredNorm();
+      nat[i] = factors[i].Ainv * G * factors[i].Sinv;
+      const double lr = l.getOptimizerParams().learningRate;
+      quad += lr * lr * nat[i].cwiseProduct(G).sum();
+      i++;
+    }
+    gradNorm = std::sqrt(gradSq);
+
+    //KL clipping: scale the step so its predicted change in the model distribution stays under klClip
+    const double nu = (opts.klClip > 0.0 and quad > opts.klClip) ? std::sqrt(opts.klClip / quad) : 1.0;
+    i = 0;
+    for(auto& l : layers){
+      l.setGradient(nu * nat[i]);
+      i++;
+    }
+    numSteps++;
+  }
+
+  bool KFACOptimizer::train(Network& net,
+			    double stopTol,
+			    size_t maxIter,
+			    std::optional<Mat> inputData,
+			    std::optional<Vec> target,
+			    bool noprint)
+  {
+    net.predict(inputData, target);
+    size_t num_iter = 0;
+    while(num_iter < maxIter){
+      precondition(net);
+      lossHistory.push_back(net.getScalarLoss());
+      if(gradNorm < stopTol){
+	return true;
+      }
+      net.updateWeights();
+      net.predict();
+      num_iter++;
+    }
+    if(not noprint){
+      std::cout << "WARNING: K-FAC HIT MAX ITERATIONS IN TRAINING. SCALAR LOSS IS "
+		<< net.getScalarLoss() << ". \n";
+    }
+    return false;
+  }
+
+}//end namespace NN
@@ -0,0 +1,133 @@
+#include <KernelFeatureLayer.hpp>
+
+
+namespace NN
+{
+
+  RandomFourierLayer::RandomFourierLayer(int_t _input_dim,
+					 int_t _num_features,
+					 double lengthscale,
+					 bool _trainable,
+					 unsigned seed) :
+    input_dim(_input_dim),
+    num_features(_num_features),
+    trainable(_trainable)
+  {
+    if(input_dim <= 0 or num_features <= 0 or lengthscale <= 0.0){
+      throw "Error: RandomFourierLayer sizes and lengthscale must be positive.";
+    }
+    std::mt19937 gen(seed);
+    std::normal_distribution<double> normal(0.0, 1.0 / lengthscale);
+    std::uniform_real_distribution<double> uniform(0.0, 2.0 * M_PI);
+
+    freqs = Mat::NullaryExpr(input_dim, num_features, [&](){ return normal(gen); });
+    phases = Mat::NullaryExpr(1, num_features, [&](){ return uniform(gen); });
+  }
+
+  void RandomFourierLayer::setFreqs(const Mat& _freqs, const Mat& _phases)
+  {
+    if(_freqs.rows() != input_dim or _freqs.cols() != num_features
+       or _phases.rows() != 1 or _phases.cols() != num_features){
+      throw "Error: frequencies must be input_dim x num_features and phases 1 x num_features.";
+    }
+    freqs = _freqs;
+    phases = _phases;
+  }
+
+  void RandomFourierLayer::forwardPass(ConstMatRef inputData)
+  {
+    if(inputData.cols() != input_dim){
+      throw "Input size error";
+    }
+    inputs = inputData;
+    actVals.noalias() = inputs * freqs;
+    actVals.rowwise() += phases.row(0);
+    outputs = std::sqrt(2.0 / num_features) * actVals.array().cos();
+  }
+
+  void RandomFourierLayer::backwardPass(ConstMatRef loss_grad)
+  {
+    //dL/d(xW + b)
+    Mat err = -std::sqrt(2.0 / num_features) * loss_grad.cwiseProduct(Mat(actVals.array().sin()));
+    inputGrad.noalias() = err * freqs.transpose();
+    if(trainable){
+      gradFreqs.noalias() = inputs.transpose() * err;
+      gradPhases = err.colwise().sum();
+    }
+  }
+
+  void RandomFourierLayer::updateWeights()
+  {
+    if(not trainable){
+      return;
+    }
+    applyUpdate(update, optParams, freqs.data(), gradFreqs.data(), stateFreqs, freqs.size());
+    applyUpdate(update, optParams, phases.data(), gradPhases.data(), statePhases, phases.size());
+  }
+
+
+  void RBFLayer::setCentres(const Mat& _centres)
+  {
+    if(_centres.rows() != num_centres or _centres.cols() != input_dim){
+      throw "Error: centres must be num_centres x input_dim.";
+    }
+    centres = _centres;
+  }
+
+  void RBFLayer::setWidths(const Mat& _widths)
+  {
+    if(_widths.size() != num_centres or _widths.minCoeff() <= 0.0){
+      throw "Error: need one positive width per centre.";
+    }
+    widths = Eigen::Map<const Mat>(_widths.data(), 1, num_centres);
+  }
+
+  void RBFLayer::forwardPass(ConstMatRef inputData)
+  {
+    if(inputData.cols() != input_dim){
+      throw "Input size error";
+    }
+    inputs = inputData;
+
+    //||x||^2 - 2 x.c + ||c||^2, clamped at zero against cancellation
+    dist2.noalias() = -2.0 * inputs * centres.transpose();
+    dist2.colwise() += inputs.rowwise().squaredNorm();
+    dist2.rowwise() += centres.rowwise().squaredNorm().transpose();
+    dist2 = dist2.cwiseMax(0.0);
+
+    Eigen::RowVectorXd gamma = (-0.5 * widths.array().square().inverse()).matrix();
+    outputs = (dist2.array().rowwise() * gamma.array()).exp();
+  }
+
+  void RBFLayer::backwardPass(ConstMatRef loss_grad)
+  {
+    //G = dL/dphi * phi, E = dL/d(dist2) = -G / (2 s^2)
+    Mat G = loss_grad.cwiseProduct(outputs);
+    Eigen::RowVectorXd gamma = (0.5 * widths.array().square().inverse()).matrix();
+    Mat E = -(G.array().rowwise() * gamma.array()).matrix();
+
+    //d(dist2_ij)/dx_i = 2 (x_i - c_j)
+    inputGrad.noalias() = -2.0 * E * centres;
+    inputGrad += 2.0 * E.rowwise().sum().asDiagonal() * inputs;
+
+    if(trainable){
+      //d(dist2_ij)/dc_j = 2 (c_j - x_i)
+      gradCentres.noalias() = -2.0 * E.transpose() * inputs;
+      gradCentres += 2.0 * E.colwise().sum().transpose().asDiagonal() * centres;
+      //d(phi_ij)/ds_j = phi_ij dist2_ij / s_j^3
+      gradWidths = G.cwiseProduct(dist2).colwise().sum().cwiseQuotient(Mat(widths.array().cube()));
+    }
+  }
+
+  void RBFLayer::updateWeights()
+  {
+    if(not trainable){
+      return;
+    }
+    applyUpdate(update, optParams, centres.data(), gradCentres.data(), stateCentres, centres.size());
+    applyUpdate(update, optParams, widths.data(), gradWidths.data(), stateWidths, widths.size());
+    //keep widths away from zero
+    widths = widths.cwiseMax(1.0e-8);
+  }
+
+}//end namespace NN
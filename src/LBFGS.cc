@@ -0,0 +1,188 @@
+#include <LBFGS.hpp>
+#include <cmath>
+#include <limits>
+
+
+namespace NN
+{
+
+  Vec LBFGSTrainer::applyInverseHessian(const Vec& g) const
+  {
+    const size_t m = sHist.size();
+    Vec q = g;
+    std::vector<double> alpha(m), rho(m);
+    for(size_t i = m; i-- > 0;){
+      rho[i] = 1.0 / yHist[i].dot(sHist[i]);
+      alpha[i] = rho[i] * sHist[i].dot(q);
+      q -= alpha[i] * yHist[i];
+    }
+    //H_0 = (s.y / y.y) I from the newest pair
+    if(m > 0){
+      q *= sHist.back().dot(yHist.back()) / yHist.back().squaredNorm();
+    }
+    for(size_t i = 0; i < m; i++){
+      const double beta = rho[i] * yHist[i].dot(q);
+      q += (alpha[i] - beta) * sHist[i];
+    }
+    return q;
+  }
+
+  namespace
+  {
+    struct LinePoint
+    {
+      double a, f, dphi;
+    };
+
+    //minimizer of the cubic through two points with slopes, safeguarded to the inner 80% of the interval
+    double interpolate(const LinePoint& lo, const LinePoint& hi)
+    {
+      const double left = std::min(lo.a, hi.a), right = std::max(lo.a, hi.a);
+      const double d1 = lo.dphi + hi.dphi - 3.0 * (lo.f - hi.f) / (lo.a - hi.a);
+      const double disc = d1 * d1 - lo.dphi * hi.dphi;
+      double a = std::numeric_limits<double>::quiet_NaN();
+      if(disc >= 0.0){
+	const double d2 = std::copysign(std::sqrt(disc), hi.a - lo.a);
+	a = hi.a - (hi.a - lo.a) * (hi.dphi + d2 - d1) / (hi.dphi - lo.dphi + 2.0 * d2);
+      }
+      const double margin = 0.1 * (right - left);
+      if(not std::isfinite(a) or a < left + margin or a > right - margin){
+	a = 0.5 * (left + right);
+      }
+      return a;
+    }
+  }
+
+  bool LBFGSTrainer::lineSearch(Network& net, Vec& x, double& f, Vec& g,
+				const Vec& d, double alpha0)
+  {
+    const double f0 = f, dphi0 = g.dot(d);
+    Vec xTrial(x.size()), gTrial(x.size());
+
+    auto evaluate = [&](double a) -> LinePoint {
+      xTrial = x + a * d;
+      const double fa = net.lossAndGradient(xTrial, gTrial);
+      numEvaluations++;
+      return {a, fa, gTrial.dot(d)};
+    };
+    auto accept = [&](const LinePoint& pt) {
+      x = xTrial;
+      g = gTrial;
+      f = pt.f;
+      return true;
+    };
+    auto armijo = [&](const LinePoint& pt) {
+      return pt.f <= f0 + opts.c1 * pt.a * dphi0;
+    };
+    auto curvature = [&](const LinePoint& pt) {
+      return std::abs(pt.dphi) <= -opts.c2 * dphi0;
+    };
+
+    int_t evals = 0;
+    auto zoom = [&](LinePoint lo, LinePoint hi) -> bool {
+      while(evals < opts.maxLineSearch){
+	LinePoint pt = evaluate(interpolate(lo, hi));
+	evals++;
+	if(not armijo(pt) or pt.f >= lo.f){
+	  hi = pt;
+	} else {
+	  if(curvature(pt)){
+	    return accept(pt);
+	  }
+	  if(pt.dphi * (hi.a - lo.a) >= 0.0){
+	    hi = lo;
+	  }
+	  lo = pt;
+	}
+      }
+      //out of evaluations: settle for lo if it decreased the loss
+      if(lo.a > 0.0 and lo.f < f0){
+	evaluate(lo.a);
+	return accept(lo);
+      }
+      return false;
+    };
+
+    LinePoint prev = {0.0, f0, dphi0};
+    double a = alpha0;
+    while(evals < opts.maxLineSearch){
+      LinePoint pt = evaluate(a);
+      evals++;
+      if(not armijo(pt) or (evals > 1 and pt.f >= prev.f)){
+	return zoom(prev, pt);
+      }
+      if(curvature(pt)){
+	return accept(pt);
+      }
+      if(pt.dphi >= 0.0){
+	return zoom(pt, prev);
+      }
+      prev = pt;
+      a *= 2.0;
+    }
+    return false;
+  }
+
+  bool LBFGSTrainer::train(Network& net,
+			   std::optional<Mat> inputData,
+			   std::optional<Vec> target,
+			   bool noprint)
+  {
+    net.predict(inputData, target);
+
+    Vec x = net.getFlatWeights();
+    Vec g(x.size());
+    double f = net.lossAndGradient(x, g);
+    numEvaluations++;
+    lossHistory.push_back(f);
+
+    sHist.clear();
+    yHist.clear();
+    for(size_t it = 0; it < opts.maxIter; it++){
+      if(g.norm() < opts.gradTol){
+	break;
+      }
+      Vec d = -applyInverseHessian(g);
+      if(g.dot(d) >= 0.0){
+	//lost descent: restart from steepest descent
+	sHist.clear();
+	yHist.clear();
+	d = -g;
+      }
+      //the first step has no curvature information to scale it
+      const double alpha0 = sHist.empty() ? std::min(1.0, 1.0 / g.norm()) : 1.0;
+
+      Vec xOld = x, gOld = g;
+      if(not lineSearch(net, x, f, g, d, alpha0)){
+	if(sHist.empty()){
+	  break;
+	}
+	sHist.clear();
+	yHist.clear();
+	net.setFlatWeights(x);
+	continue;
+      }
+      lossHistory.push_back(f);
+
+      Vec s = x - xOld, y = g - gOld;
+      //only keep pairs that preserve positive definiteness
+      if(s.dot(y) > 1.0e-12 * s.norm() * y.norm()){
+	sHist.push_back(s);
+	yHist.push_back(y);
+	if(static_cast<int_t>(sHist.size()) > opts.historySize){
+	  sHist.pop_front();
+	  yHist.pop_front();
+	}
+      }
+    }
+    net.setFlatWeights(x);
+    net.predict();
+    const bool converged = g.norm() < opts.gradTol;
+    if(not converged and not noprint){
+      std::cout << "WARNING: L-BFGS STOPPED BEFORE REACHING THE GRADIENT TOLERANCE. SCALAR LOSS IS "
+		<< f << ". \n";
+    }
+    return converged;
+  }
+
+}//end namespace NN
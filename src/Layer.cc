@@ -29,13 +29,36 @@ namespace NN
     if(usemakeInputMat){
       inputMat = makeInputMat(inputs);
     }
-    setInputShape(std::make_pair(inputs.rows(), inputs.cols()));
+    //a new batch size keeps the trained weights; only a new feature count needs fresh ones
+    bool reinit = weights.rows() != inputs.cols() + 1 or weights.cols() != output_size;
+    setInputShape(std::make_pair(inputs.rows(), inputs.cols()), reinit);
   }
 
   void Layer::setActivation(std::string actName)
   {
     activation = ACTIVATIONS[actName];
     activation_grad = ACTIVATION_DERIVATIVES[actName];
+    activation_grad2 = ACTIVATION_SECOND_DERIVATIVES[actName];
+    activationName = actName;
+  }
+
+  Mat Layer::invertActivation(ConstMatRef y) const
+  {
+    //keep targets on the boundary of the range finite
+    const double eps = 1.0e-12;
+    if(activationName == "linear"){
+      return y;
+    } else if(activationName == "sigmoid"){
+      return y.unaryExpr([eps](double v){
+	  v = std::clamp(v, eps, 1.0 - eps);
+	  return std::log(v / (1.0 - v));
+	});
+    } else if(activationName == "tanh"){
+      return y.unaryExpr([eps](double v){
+	  return std::atanh(std::clamp(v, -1.0 + eps, 1.0 - eps));
+	});
+    }
+    throw "Error: only linear, sigmoid and tanh activations can be inverted.";
   }
 
   void Layer::forwardPass(ConstMatRef inputData)
@@ -75,18 +98,14 @@ namespace NN
 
   void Layer::backwardPass(const Layer& next) noexcept
   {
-    Mat loss_g;
-    #pragma omp parallel
-    {
-     loss_g = next.getErr() * next.getWeights().transpose();
-    }
-
-    loss_g.conservativeResize(loss_g.rows(), loss_g.cols()-1);
+    Mat loss_g = next.getInputGrad();
 
     auto actDerivs = makeActDerivs();
     err = loss_g.cwiseProduct(actDerivs);
 				
     gradient = inputMat.transpose() * err;
+    //while the gradient is still in cache, for Network's global norm
+    gradNormSq = gradient.squaredNorm();
 	
     }
 
@@ -97,32 +116,153 @@ namespace NN
     err = loss_grad.cwiseProduct(actDerivs);
 			
     gradient = inputMat.transpose() * err;
+    gradNormSq = gradient.squaredNorm();
   }
 
 
-  void Layer::updateWeights()
+  void Layer::forwardTangents(ConstMatRef inputData, std::vector<Mat>& tangents)
   {
-    //if constexpr(update == UpdateRule::NesterovAccGrad){
-	//if we're using Nesterov accelerated grad, params are learning rate, momentum
-    auto [learningRate, momentum] = updateParams;
-	
-    #pragma omp parallel
-    {
-      weightUpdate = momentum * weightUpdate - learningRate * gradient;
+    forwardPass(inputData);
+    auto actDerivs = makeActDerivs();
+    auto W = weights.topRows(input_shape.second);
 
-      weights += weightUpdate;
+    inputTangents = tangents;
+    actTangents.resize(tangents.size());
+    for(size_t k = 0; k < tangents.size(); k++){
+      //the bias does not depend on the inputs
+      actTangents[k].noalias() = inputTangents[k] * W;
+      tangents[k] = actDerivs.cwiseProduct(actTangents[k]);
     }
-	//} else {
-	//throw "Error: only NesterovAccGrad is implemented now.";
-	//}
   }
 
+  void Layer::backwardTangents(ConstMatRef loss_grad, std::vector<Mat>& tangentGrads)
+  {
+    if(tangentGrads.size() != actTangents.size()){
+      throw "Error: need one tangent gradient per tangent from forwardTangents().";
+    }
+    if(not activation_grad2){
+      throw "Error: input derivatives need a named activation with a second derivative.";
+    }
+    auto actDerivs = makeActDerivs();
+    Mat actSecond = activation_grad2(std::make_pair(actVals, outputs));
+    auto W = weights.topRows(input_shape.second);
+
+    //outputs = f(a) and tangent_k = f'(a) * a_k, so a picks up f''(a) * sum_k tangentGrad_k * a_k
+    err = loss_grad.cwiseProduct(actDerivs);
+    gradient = Mat::Zero(weights.rows(), weights.cols());
+    for(size_t k = 0; k < tangentGrads.size(); k++){
+      err += actSecond.cwiseProduct(tangentGrads[k].cwiseProduct(actTangents[k]));
+      Mat tangentErr = tangentGrads[k].cwiseProduct(actDerivs);
+      gradient.topRows(input_shape.second).noalias() += inputTangents[k].transpose() * tangentErr;
+      tangentGrads[k].noalias() = tangentErr * W.transpose();
+    }
+    gradient.noalias() += inputMat.transpose() * err;
+    gradNormSq = gradient.squaredNorm();
+  }
+
+
+  Mat Layer::forwardR(ConstMatRef inputsR, ConstMatRef V)
+  {
+    if(V.rows() != weights.rows() or V.cols() != weights.cols()){
+      throw "Error: R-operator direction must have the shape of the weights.";
+    }
+    inputR = inputsR;
+    actR.noalias() = inputMat * V;
+    if(inputR.size() > 0){
+      actR.noalias() += inputR * weights.topRows(input_shape.second);
+    }
+    return makeActDerivs().cwiseProduct(actR);
+  }
+
+  Mat Layer::backwardR(ConstMatRef loss_grad, ConstMatRef loss_gradR, ConstMatRef V,
+		       MatRef gradientR, bool gaussNewton)
+  {
+    auto actDerivs = makeActDerivs();
+    auto W = weights.topRows(input_shape.second);
+    err = loss_grad.cwiseProduct(actDerivs);
+
+    Mat errR = loss_gradR.cwiseProduct(actDerivs);
+    if(not gaussNewton){
+      if(not activation_grad2){
+	throw "Error: Hessian products need a named activation with a second derivative.";
+      }
+      Mat actSecond = activation_grad2(std::make_pair(actVals, outputs));
+      errR += loss_grad.cwiseProduct(actSecond).cwiseProduct(actR);
+    }
+
+    gradientR.noalias() = inputMat.transpose() * errR;
+    Mat inputGradR = errR * W.transpose();
+    if(not gaussNewton){
+      if(inputR.size() > 0){
+	gradientR.topRows(input_shape.second).noalias() += inputR.transpose() * err;
+      }
+      inputGradR.noalias() += err * V.topRows(input_shape.second).transpose();
+    }
+    return inputGradR;
+  }
+
+
+  void Layer::perSampleGradients(MatRef J) const
+  {
+    if(J.rows() != err.rows() or J.cols() != weights.size()){
+      throw "Error: per-sample gradient block must be (batch size) x numParams().";
+    }
+    const int_t nOut = weights.cols();
+    for(int_t i = 0; i < err.rows(); i++){
+      for(int_t r = 0; r < weights.rows(); r++){
+	J.row(i).segment(r * nOut, nOut) = inputMat(i, r) * err.row(i);
+      }
+    }
+  }
+
+  void Layer::accumulateKroneckerFactors(Mat& A, Mat& S, double decay) const
+  {
+    if(A.rows() != weights.rows() or S.rows() != weights.cols()){
+      A = Mat::Zero(weights.rows(), weights.rows());
+      S = Mat::Zero(weights.cols(), weights.cols());
+      decay = 0.0;
+    }
+    A *= decay;
+    S *= decay;
+    A.selfadjointView<Eigen::Lower>().rankUpdate(inputMat.transpose(), (1.0 - decay) / inputMat.rows());
+    S.selfadjointView<Eigen::Lower>().rankUpdate(err.transpose(), 1.0 - decay);
+  }
+
+  void Layer::updateWeights()
+  {
+    updateWeights(1.0, 1.0);
+  }
 
   void Layer::updateWeights(double mult)
   {
-    updateWeights();
-    #pragma omp parallel
-    weights *= mult;
+    updateWeights(mult, 1.0);
+  }
+
+  void Layer::updateWeights(double mult, double gradScale)
+  {
+    if(gradient.rows() != weights.rows() or gradient.cols() != weights.cols()){
+      throw "Error: gradient does not match the weights; run backwardPass first.";
+    }
+    if(averageSwapped){
+      throw "Error: the averaged weights are swapped in; swap them back before updating.";
+    }
+    //give the average the weights' shape so that swapAveragedWeights() can exchange them
+    if(optParams.averaging != Averaging::None and optState.average.size() != weights.size()){
+      optState.average = weights;
+      optState.numAveraged = 0;
+    }
+    //the regularizers and mult skip the bias row, the last weights.cols() entries
+    applyUpdate(update, optParams, weights.data(), gradient.data(), optState, weights.size(),
+		weights.size() - weights.cols(), weights.cols(), mult, gradScale);
+  }
+
+  void Layer::swapAveragedWeights()
+  {
+    if(not hasAveragedWeights()){
+      throw "Error: no averaged weights; set OptimizerParams::averaging and update first.";
+    }
+    weights.swap(optState.average);
+    averageSwapped = not averageSwapped;
   }
 
   void Layer::visualizeLayer(std::ostream& ostr) 
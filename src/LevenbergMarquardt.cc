@@ -0,0 +1,119 @@
+#include <LevenbergMarquardt.hpp>
+#include <algorithm>
+#include <cmath>
+
+
+namespace NN
+{
+
+  Vec LevenbergMarquardtTrainer::solveCG(const Mat& J, const Vec& damping, const Vec& rhs) const
+  {
+    //Jacobi preconditioner: diag(J^T J) + lambda D
+    Vec precond = J.colwise().squaredNorm().transpose() + damping;
+    precond = precond.cwiseMax(1.0e-300).cwiseInverse();
+
+    Vec x = Vec::Zero(rhs.size());
+    Vec r = rhs;
+    Vec z = precond.cwiseProduct(r);
+    Vec p = z;
+    Vec Jp(J.rows()), Ap(rhs.size());
+    double rz = r.dot(z);
+    const double stop = opts.cgTol * opts.cgTol * rhs.squaredNorm();
+    for(int_t k = 0; k < opts.cgMaxIter and r.squaredNorm() > stop; k++){
+      Jp.noalias() = J * p;
+      Ap.noalias() = J.transpose() * Jp;
+      Ap += damping.cwiseProduct(p);
+      const double alpha = rz / p.dot(Ap);
+      x += alpha * p;
+      r -= alpha * Ap;
+      z = precond.cwiseProduct(r);
+      const double rzNew = r.dot(z);
+      p = z + (rzNew / rz) * p;
+      rz = rzNew;
+    }
+    return x;
+  }
+
+  bool LevenbergMarquardtTrainer::train(Network& net,
+					std::optional<Mat> inputData,
+					std::optional<Vec> target,
+					bool noprint)
+  {
+    net.predict(inputData, target);
+    const int_t P = net.numParams();
+    const bool direct = P <= opts.directMaxParams;
+
+    Vec x = net.getFlatWeights();
+    double loss = net.getScalarLoss();
+    lossHistory.push_back(loss);
+
+    Mat J;
+    Eigen::MatrixXd JtJ;
+    Vec g, diagJtJ;
+    auto linearize = [&]() {
+      J = net.outputJacobian();
+      Vec r = net.getResidual();
+      g.noalias() = J.transpose() * r;
+      diagJtJ = J.colwise().squaredNorm().transpose();
+      if(direct){
+	JtJ.setZero(P, P);
+	JtJ.selfadjointView<Eigen::Lower>().rankUpdate(J.transpose());
+      }
+    };
+    linearize();
+
+    const double maxDiag = std::max(diagJtJ.maxCoeff(), 1.0e-12);
+    lambda = opts.initialDamping * maxDiag;
+    double nu = 2.0;
+
+    bool converged = false;
+    for(size_t it = 0; it < opts.maxIter; it++){
+      if(g.norm() < opts.gradTol or loss < opts.lossTol){
+	converged = true;
+	break;
+      }
+      Vec D = opts.marquardtScaling ? Vec(diagJtJ.cwiseMax(1.0e-12 * maxDiag)) : Vec(Vec::Ones(P));
+      Vec damping = lambda * D;
+
+      Vec delta;
+      if(direct){
+	Eigen::MatrixXd A = JtJ;
+	A.diagonal() += damping;
+	delta = A.selfadjointView<Eigen::Lower>().ldlt().solve(-g);
+      } else {
+	delta = solveCG(J, damping, -g);
+      }
+
+      //reduction predicted by the damped quadratic model
+      const double predicted = 0.5 * delta.dot(damping.cwiseProduct(delta) - g);
+      net.setFlatWeights(x + delta);
+      net.predict();
+      const double newLoss = net.getScalarLoss();
+      const double rho = predicted > 0.0 ? (loss - newLoss) / predicted : -1.0;
+
+      if(rho > 0.0 and std::isfinite(newLoss)){
+	x += delta;
+	loss = newLoss;
+	lossHistory.push_back(loss);
+	linearize();
+	lambda *= std::max(1.0 / 3.0, 1.0 - std::pow(2.0 * rho - 1.0, 3));
+	nu = 2.0;
+      } else {
+	lambda *= nu;
+	nu *= 2.0;
+	if(lambda > 1.0e16 * maxDiag){
+	  break;
+	}
+      }
+    }
+
+    net.setFlatWeights(x);
+    net.predict();
+    if(not converged and not noprint){
+      std::cout << "WARNING: LEVENBERG-MARQUARDT STOPPED BEFORE REACHING ITS TOLERANCES. SCALAR LOSS IS "
+		<< loss << ". \n";
+    }
+    return converged;
+  }
+
+}//end namespace NN
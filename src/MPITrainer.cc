@@ -0,0 +1,410 @@
+#include <MPITrainer.hpp>
+
+#ifdef NN_HAVE_MPI
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <numeric>
+#include <random>
+
+
+namespace NN
+{
+
+  MPIDataParallelTrainer::MPIDataParallelTrainer(MPI_Comm _comm, const MPITrainerOptions& _opts) :
+    comm(_comm),
+    opts(_opts),
+    compressor(_opts.compression)
+  {
+    if(opts.zeroStage < 0 or opts.zeroStage > 2){
+      throw "Error: zeroStage must be 0, 1 or 2.";
+    }
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+  }
+
+  void MPIDataParallelTrainer::makeBuckets(Network& net)
+  {
+    const bool compressed = opts.compression.method != Compression::None;
+    shape.clear();
+    for(const auto& l : net.getLayersRef()){
+      shape.emplace_back(l.getInputShape().second + 1, l.getOutputSize());
+    }
+    buckets.clear();
+    lowRankLayers.clear();
+    bucketOf.assign(shape.size(), 0);
+    offsetOf.assign(shape.size(), 0);
+    flatOffset.assign(shape.size() + 1, 0);
+    for(size_t l = 0; l < shape.size(); l++){
+      flatOffset[l + 1] = flatOffset[l] + shape[l].first * shape[l].second;
+    }
+
+    //last layer first, the order the backward pass finishes them
+    size_t bytes = opts.bucketBytes;
+    for(size_t l = shape.size(); l-- > 0;){
+      const auto [rows, cols] = shape[l];
+      if(compressor.lowRank(rows, cols)){
+	lowRankLayers.push_back(l);
+	continue;
+      }
+      if(bytes >= opts.bucketBytes){
+	buckets.emplace_back();
+	bytes = 0;
+      }
+      Bucket& b = buckets.back();
+      bucketOf[l] = buckets.size() - 1;
+      b.layers.push_back(l);
+      if(compressed){
+	const size_t layerBytes = compressor.payloadBytes(rows, cols);
+	offsetOf[l] = b.payload.size();
+	b.payload.resize(b.payload.size() + layerBytes);
+	b.gathered.resize(b.payload.size() * size);
+	bytes += layerBytes;
+      } else {
+	offsetOf[l] = b.buf.size();
+	b.buf.conservativeResize(b.buf.size() + rows * cols);
+	bytes += sizeof(double) * rows * cols;
+      }
+    }
+
+    //an uncompressed bucket's layers are consecutive; lay them out in flat order
+    for(auto& b : buckets){
+      if(b.payload.empty()){
+	b.flatBegin = flatOffset[b.layers.back()];
+	for(size_t l : b.layers){
+	  offsetOf[l] = flatOffset[l] - b.flatBegin;
+	}
+      }
+    }
+
+    if(opts.zeroStage > 0){
+      const int_t P = flatOffset.back();
+      shardBounds.resize(size + 1);
+      for(int r = 0; r <= size; r++){
+	shardBounds[r] = P * r / size;
+      }
+      shardGrad.resize(shardBounds[rank + 1] - shardBounds[rank]);
+      shardState.assign(shape.size(), OptimizerState());
+      shardRule.clear();
+      for(const auto& l : net.getLayersRef()){
+	shardRule.push_back(l.getUpdateRule());
+      }
+      for(auto& b : buckets){
+	const int_t begin = b.flatBegin, end = begin + b.buf.size();
+	b.scatterCounts.resize(size);
+	for(int r = 0; r < size; r++){
+	  b.scatterCounts[r] = std::max(int_t(0), std::min(end, shardBounds[r + 1]) - std::max(begin, shardBounds[r]));
+	}
+	b.shardOffset = std::clamp(begin - shardBounds[rank], int_t(0), shardGrad.size());
+      }
+    }
+  }
+
+  bool MPIDataParallelTrainer::bucketsMatch(Network& net) const
+  {
+    if(shape.empty() or shape.size() != net.getLayersRef().size() or flatOffset.back() != net.numParams()){
+      return false;
+    }
+    size_t l = 0;
+    for(const auto& layer : net.getLayersRef()){
+      if(shape[l] != std::make_pair(layer.getInputShape().second + 1, layer.getOutputSize())){
+	return false;
+      }
+      l++;
+    }
+    return true;
+  }
+
+  void MPIDataParallelTrainer::gradientReady(size_t index, const Layer& layer)
+  {
+    if(compressor.lowRank(layer.getInputShape().second + 1, layer.getOutputSize())){
+      return;
+    }
+    Bucket& b = buckets[bucketOf[index]];
+    if(b.payload.empty()){
+      layer.copyGradientTo(b.buf.data() + offsetOf[index]);
+    } else {
+      compressor.encode(index, layer.getGradient(), b.payload.data() + offsetOf[index]);
+    }
+    bytesDense += sizeof(double) * layer.numParams();
+    if(--b.pending == 0){
+      if(b.payload.empty() and opts.zeroStage == 2){
+	MPI_Ireduce_scatter(b.buf.data(), shardGrad.data() + b.shardOffset, b.scatterCounts.data(),
+			    MPI_DOUBLE, MPI_SUM, comm, &b.request);
+	bytesSent += sizeof(double) * b.buf.size();
+      } else if(b.payload.empty()){
+	MPI_Iallreduce(MPI_IN_PLACE, b.buf.data(), b.buf.size(), MPI_DOUBLE, MPI_SUM, comm, &b.request);
+	bytesSent += sizeof(double) * b.buf.size();
+      } else {
+	MPI_Iallgather(b.payload.data(), b.payload.size(), MPI_BYTE,
+		       b.gathered.data(), b.payload.size(), MPI_BYTE, comm, &b.request);
+	bytesSent += b.payload.size();
+      }
+    }
+    //give the library a chance to progress the reductions already in flight
+    for(auto& other : buckets){
+      if(other.request != MPI_REQUEST_NULL){
+	int done;
+	MPI_Test(&other.request, &done, MPI_STATUS_IGNORE);
+      }
+    }
+  }
+
+  void MPIDataParallelTrainer::reduceLowRank(Network& net)
+  {
+    if(lowRankLayers.empty()){
+      return;
+    }
+    const int_t r = opts.compression.rank;
+    std::vector<Layer*> layers;
+    for(auto& l : net.getLayersRef()){
+      layers.push_back(&l);
+    }
+    //all P factors in one sum, then all Q factors in another
+    int_t pSize = 0, qSize = 0;
+    for(size_t l : lowRankLayers){
+      pSize += (layers[l]->getInputShape().second + 1) * r;
+      qSize += layers[l]->getOutputSize() * r;
+    }
+    Vec P(pSize), Q(qSize);
+    auto factors = [&](size_t l, int_t& pOff, int_t& qOff) {
+      const int_t rows = layers[l]->getInputShape().second + 1, cols = layers[l]->getOutputSize();
+      Eigen::Map<Mat> Pl(P.data() + pOff, rows, r), Ql(Q.data() + qOff, cols, r);
+      pOff += rows * r;
+      qOff += cols * r;
+      return std::make_pair(Pl, Ql);
+    };
+
+    int_t pOff = 0, qOff = 0;
+    for(size_t l : lowRankLayers){
+      auto [Pl, Ql] = factors(l, pOff, qOff);
+      compressor.lowRankP(l, layers[l]->getGradient(), Pl);
+      bytesDense += sizeof(double) * layers[l]->numParams();
+    }
+    MPI_Allreduce(MPI_IN_PLACE, P.data(), P.size(), MPI_DOUBLE, MPI_SUM, comm);
+    pOff = qOff = 0;
+    for(size_t l : lowRankLayers){
+      auto [Pl, Ql] = factors(l, pOff, qOff);
+      compressor.lowRankQ(l, Pl, Ql);
+    }
+    MPI_Allreduce(MPI_IN_PLACE, Q.data(), Q.size(), MPI_DOUBLE, MPI_SUM, comm);
+    bytesSent += sizeof(double) * (P.size() + Q.size());
+    pOff = qOff = 0;
+    for(size_t l : lowRankLayers){
+      auto [Pl, Ql] = factors(l, pOff, qOff);
+      Mat sum(Pl.rows(), Ql.rows());
+      compressor.lowRankFinish(l, Pl, Ql, size, sum);
+      layers[l]->setGradient(sum);
+    }
+  }
+
+  void MPIDataParallelTrainer::shardedUpdate(Network& net)
+  {
+    const int_t begin = shardBounds[rank], end = shardBounds[rank + 1];
+    if(opts.zeroStage == 1){
+      //the allreduced layer gradients are in their buckets
+      for(size_t l = 0; l < bucketOf.size(); l++){
+	const int_t lo = std::max(begin, flatOffset[l]), hi = std::min(end, flatOffset[l + 1]);
+	if(lo < hi){
+	  const Bucket& b = buckets[bucketOf[l]];
+	  std::copy_n(b.buf.data() + (lo - b.flatBegin), hi - lo, shardGrad.data() + (lo - begin));
+	}
+      }
+    }
+    //the global norm for clipping: every rank holds one shard of the summed gradient
+    double scale = 1.0;
+    if(net.getGradientClipping() > 0.0){
+      double sq = shardGrad.squaredNorm();
+      MPI_Allreduce(MPI_IN_PLACE, &sq, 1, MPI_DOUBLE, MPI_SUM, comm);
+      scale = net.clipScale(std::sqrt(sq));
+    }
+    Vec flat = net.getFlatWeights();
+    size_t l = 0;
+    for(const auto& layer : net.getLayersRef()){
+      if(shardRule[l] != layer.getUpdateRule()){
+	shardState[l].reset();
+	shardRule[l] = layer.getUpdateRule();
+      }
+      const int_t lo = std::max(begin, flatOffset[l]), hi = std::min(end, flatOffset[l + 1]);
+      if(lo < hi){
+	//the layer's bias row, its last getOutputSize() weights, is not regularized
+	const int_t biasBegin = flatOffset[l + 1] - layer.getOutputSize();
+	applyUpdate(layer.getUpdateRule(), layer.getOptimizerParams(), flat.data() + lo,
+		    shardGrad.data() + (lo - begin), shardState[l], hi - lo,
+		    std::max<int_t>(0, std::min(hi, biasBegin) - lo), 0, 1.0, scale);
+      }
+      l++;
+    }
+
+    std::vector<int> counts(size), displs(size);
+    for(int r = 0; r < size; r++){
+      counts[r] = shardBounds[r + 1] - shardBounds[r];
+      displs[r] = shardBounds[r];
+    }
+    MPI_Allgatherv(MPI_IN_PLACE, 0, MPI_DATATYPE_NULL, flat.data(), counts.data(), displs.data(),
+		   MPI_DOUBLE, comm);
+    bytesSent += sizeof(double) * (end - begin);
+    net.setFlatWeights(flat);
+  }
+
+  size_t MPIDataParallelTrainer::shardStateSize() const noexcept
+  {
+    size_t n = 0;
+    for(const auto& st : shardState){
+      n += st.moment1.size() + st.moment2.size();
+    }
+    return n;
+  }
+
+  void MPIDataParallelTrainer::broadcastWeights(Network& net) const
+  {
+    Vec w = net.getFlatWeights();
+    MPI_Bcast(w.data(), w.size(), MPI_DOUBLE, 0, comm);
+    net.setFlatWeights(w);
+  }
+
+  double MPIDataParallelTrainer::step(Network& net, ConstMatRef batchInputs, Eigen::Ref<const Vec> batchTarget)
+  {
+    auto& layers = net.getLayersRef();
+    if(opts.zeroStage > 0){
+      if(opts.compression.method != Compression::None){
+	throw "Error: ZeRO sharding needs uncompressed gradients.";
+      }
+      for(const auto& layer : layers){
+	if(layer.getUpdateRule() == UpdateRule::LARS or layer.getUpdateRule() == UpdateRule::LAMB){
+	  throw "Error: ZeRO sharding cuts across layers; LARS and LAMB need whole layers.";
+	}
+	if(layer.getOptimizerParams().maxNorm > 0.0){
+	  throw "Error: ZeRO sharding cuts across columns; maxNorm needs whole layers.";
+	}
+	if(layer.getOptimizerParams().averaging != Averaging::None){
+	  throw "Error: ZeRO sharding keeps each rank's averages for its shard only; averaging needs whole layers.";
+	}
+      }
+    }
+    if(not bucketsMatch(net)){
+      makeBuckets(net);
+    }
+    for(auto& b : buckets){
+      b.pending = b.layers.size();
+    }
+
+    net.setBatch(batchInputs, batchTarget);
+    net.predict();
+    net.setGradientHook([this](size_t index, Layer& layer) { gradientReady(index, layer); });
+    try {
+      net.backwardPass();
+    } catch(...) {
+      net.setGradientHook(nullptr);
+      //MPI can't cancel a collective: let the reductions already started finish before
+      //their buffers are reused
+      for(auto& b : buckets){
+	MPI_Wait(&b.request, MPI_STATUS_IGNORE);
+	b.pending = b.layers.size();
+      }
+      throw;
+    }
+    net.setGradientHook(nullptr);
+    reduceLowRank(net);
+
+    double loss = net.getScalarLoss();
+    auto t0 = std::chrono::steady_clock::now();
+    std::vector<MPI_Request> requests;
+    for(const auto& b : buckets){
+      requests.push_back(b.request);
+    }
+    MPI_Waitall(requests.size(), requests.data(), MPI_STATUSES_IGNORE);
+    waitSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    for(auto& b : buckets){
+      b.request = MPI_REQUEST_NULL;
+    }
+
+    if(opts.zeroStage > 0){
+      shardedUpdate(net);
+      MPI_Allreduce(MPI_IN_PLACE, &loss, 1, MPI_DOUBLE, MPI_SUM, comm);
+      return loss;
+    }
+
+    size_t l = 0;
+    for(auto& layer : layers){
+      const int_t rows = layer.getInputShape().second + 1, cols = layer.getOutputSize();
+      if(compressor.lowRank(rows, cols)){
+	l++;
+	continue;
+      }
+      const Bucket& b = buckets[bucketOf[l]];
+      if(b.payload.empty()){
+	layer.setGradient(Eigen::Map<const Mat>(b.buf.data() + offsetOf[l], rows, cols));
+      } else {
+	//the same decoding order on every rank keeps the ranks' weights identical
+	Mat sum = Mat::Zero(rows, cols);
+	for(int r = 0; r < size; r++){
+	  compressor.decodeAdd(b.gathered.data() + r * b.payload.size() + offsetOf[l], sum);
+	}
+	layer.setGradient(sum);
+      }
+      l++;
+    }
+    net.updateWeights();
+
+    MPI_Allreduce(MPI_IN_PLACE, &loss, 1, MPI_DOUBLE, MPI_SUM, comm);
+    return loss;
+  }
+
+  void MPIDataParallelTrainer::train(Network& net, ConstMatRef X, Eigen::Ref<const Vec> y, bool noprint)
+  {
+    const int_t n = X.rows();
+    if(opts.batchSize <= 0){
+      throw "Error: batch size must be positive.";
+    }
+    //a rank that threw alone would leave the others waiting in the collectives below
+    int bad = y.size() != n or n == 0;
+    MPI_Allreduce(MPI_IN_PLACE, &bad, 1, MPI_INT, MPI_LOR, comm);
+    if(y.size() != n){
+      throw "Error: need one target per data row.";
+    }
+    if(n == 0){
+      throw "Error: every rank needs at least one data row.";
+    }
+    if(bad){
+      throw "Error: another rank's data shard is unusable.";
+    }
+    long long localRows = n, totalRows = 0, steps = (n + opts.batchSize - 1) / opts.batchSize;
+    MPI_Allreduce(&localRows, &totalRows, 1, MPI_LONG_LONG, MPI_SUM, comm);
+    MPI_Allreduce(MPI_IN_PLACE, &steps, 1, MPI_LONG_LONG, MPI_MAX, comm);
+
+    broadcastWeights(net);
+    std::vector<int_t> permutation(n);
+    std::iota(permutation.begin(), permutation.end(), 0);
+    std::mt19937_64 gen(opts.seed + rank);
+    Mat batchInputs;
+    Vec batchTarget;
+
+    for(size_t epoch = 0; epoch < opts.epochs; epoch++){
+      std::shuffle(permutation.begin(), permutation.end(), gen);
+      double epochSum = 0.0, epochRows = 0.0;
+      for(long long s = 0; s < steps; s++){
+	const int_t rows = std::min(opts.batchSize, n);
+	batchInputs.resize(rows, X.cols());
+	batchTarget.resize(rows);
+	for(int_t j = 0; j < rows; j++){
+	  const int_t idx = permutation[(s * opts.batchSize + j) % n];
+	  batchInputs.row(j) = X.row(idx);
+	  batchTarget[j] = y[idx];
+	}
+	epochSum += step(net, batchInputs, batchTarget);
+	epochRows += rows;
+      }
+      MPI_Allreduce(MPI_IN_PLACE, &epochRows, 1, MPI_DOUBLE, MPI_SUM, comm);
+      epochLoss.push_back(epochSum / epochRows);
+      if(not noprint and rank == 0){
+	std::cout << "epoch " << epoch + 1 << ": mean loss " << epochLoss.back()
+		  << " over " << totalRows << " rows on " << size << " ranks\n";
+      }
+    }
+  }
+
+}//end namespace NN
+
+#endif //NN_HAVE_MPI
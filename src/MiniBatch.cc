@@ -0,0 +1,95 @@
+#include <MiniBatch.hpp>
+#include <algorithm>
+#include <numeric>
+
+
+namespace NN
+{
+
+  int_t MiniBatchTrainer::stepsPerEpoch(int_t n) const noexcept
+  {
+    if(opts.finalBatch == FinalBatch::DropLast){
+      return n / opts.batchSize;
+    }
+    return (n + opts.batchSize - 1) / opts.batchSize;
+  }
+
+  void MiniBatchTrainer::gatherBatch(ConstMatRef X, Eigen::Ref<const Vec> y, int_t start, int_t rows)
+  {
+    const int_t n = permutation.size();
+    if(batchInputs.rows() != rows){
+      batchInputs.resize(rows, X.cols());
+      batchTarget.resize(rows);
+    }
+    for(int_t j = 0; j < rows; j++){
+      //past the end only happens when padding
+      const int_t idx = permutation[(start + j) % n];
+      batchInputs.row(j) = X.row(idx);
+      batchTarget[j] = y[idx];
+    }
+  }
+
+  void MiniBatchTrainer::train(Network& net, ConstMatRef X, Eigen::Ref<const Vec> y, bool noprint)
+  {
+    const int_t n = X.rows();
+    if(y.size() != n){
+      throw "Error: need one target per data row.";
+    }
+    if(opts.batchSize <= 0){
+      throw "Error: batch size must be positive.";
+    }
+    const int_t steps = stepsPerEpoch(n);
+    if(steps == 0){
+      throw "Error: dropping the last batch leaves no batches; the data set is smaller than a batch.";
+    }
+
+    if(opts.numThreads > 1 and (not parallel or parallel->getNumThreads() != opts.numThreads)){
+      parallel = std::make_unique<DataParallelTrainer>(opts.numThreads);
+    }
+
+    permutation.resize(n);
+    std::iota(permutation.begin(), permutation.end(), 0);
+    batchInputs.resize(std::min(opts.batchSize, n), X.cols());
+    batchTarget.resize(batchInputs.rows());
+
+    for(size_t epoch = 0; epoch < opts.epochs; epoch++){
+      if(opts.shuffle){
+	std::shuffle(permutation.begin(), permutation.end(), gen);
+      }
+      double epochSum = 0.0;
+      int_t epochRows = 0;
+      for(int_t s = 0; s < steps; s++){
+	const int_t start = s * opts.batchSize;
+	const int_t rows = opts.finalBatch == FinalBatch::Partial ?
+	  std::min(opts.batchSize, n - start) : opts.batchSize;
+	gatherBatch(X, y, start, rows);
+
+	double loss;
+	if(parallel){
+	  loss = parallel->step(net, batchInputs, batchTarget);
+	} else if(opts.memoryBudget > 0){
+	  loss = net.accumulateAndUpdate(batchInputs, batchTarget, opts.memoryBudget);
+	} else {
+	  net.setBatch(batchInputs, batchTarget);
+	  net.predict();
+	  net.backwardPass();
+	  net.updateWeights();
+	  loss = net.getScalarLoss();
+	}
+
+	const double perSample = loss / rows;
+	batchLoss.push_back(perSample);
+	runningLoss.push_back(runningLoss.empty() ? perSample :
+			      opts.runningDecay * runningLoss.back() + (1.0 - opts.runningDecay) * perSample);
+	epochSum += loss;
+	epochRows += rows;
+      }
+      epochLoss.push_back(epochSum / epochRows);
+      if(not noprint){
+	std::cout << "epoch " << epoch + 1 << ": mean loss " << epochLoss.back()
+		  << ", running loss " << runningLoss.back() << '\n';
+      }
+    }
+  }
+
+}//end namespace NN
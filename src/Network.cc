@@ -38,6 +38,18 @@ namespace NN
     }
   }
 
+  void Network::setBatch(ConstMatRef batchInputs, Eigen::Ref<const Vec> batchTarget)
+  {
+    if(batchInputs.cols() != input_shape.second){
+      throw "Error: batch must have number of cols of input_shape.second";
+    } else if(batchTarget.size() != batchInputs.rows()){
+      throw "Error: batch target must have one entry per batch row";
+    }
+    inputs = batchInputs;
+    target = batchTarget;
+    input_shape.first = inputs.rows();
+  }
+
   void Network::setLayers(const std::list<Layer>& newLayers)
   {
     layers = newLayers;
@@ -103,6 +115,101 @@ namespace NN
     }
   }
 
+  Vec Network::getFlatWeights() const
+  {
+    Vec params(numParams());
+    int_t offset = 0;
+    for(const auto& l : layers){
+      l.copyWeightsTo(params.data() + offset);
+      offset += l.numParams();
+    }
+    return params;
+  }
+
+  void Network::setFlatWeights(Eigen::Ref<const Vec> params)
+  {
+    if(params.size() != numParams()){
+      throw "Error: flat weight vector must have numParams() entries.";
+    }
+    int_t offset = 0;
+    for(auto& l : layers){
+      l.setWeightsFrom(params.data() + offset);
+      offset += l.numParams();
+    }
+  }
+
+  Vec Network::getFlatGradient() const
+  {
+    Vec grad(numParams());
+    int_t offset = 0;
+    for(const auto& l : layers){
+      l.copyGradientTo(grad.data() + offset);
+      offset += l.numParams();
+    }
+    return grad;
+  }
+
+  double Network::lossAndGradient(Eigen::Ref<const Vec> params, Eigen::Ref<Vec> grad)
+  {
+    setFlatWeights(params);
+    predict();
+    backwardPass();
+    int_t offset = 0;
+    for(const auto& l : layers){
+      l.copyGradientTo(grad.data() + offset);
+      offset += l.numParams();
+    }
+    return scalar_loss;
+  }
+
+  Mat Network::outputJacobian()
+  {
+    backwardLayers(Vec::Ones(outputs.size()));
+    Mat J(outputs.size(), numParams());
+    int_t offset = 0;
+    for(const auto& l : layers){
+      l.perSampleGradients(J.middleCols(offset, l.numParams()));
+      offset += l.numParams();
+    }
+    return J;
+  }
+
+  Vec Network::hessianVectorProduct(Eigen::Ref<const Vec> v, bool gaussNewton)
+  {
+    if(v.size() != numParams()){
+      throw "Error: Hessian-vector product needs a vector with numParams() entries.";
+    }
+    using ConstMatMap = Eigen::Map<const Mat>;
+    std::vector<ConstMatMap> dirs;
+    int_t offset = 0;
+    for(const auto& l : layers){
+      dirs.emplace_back(v.data() + offset, l.getInputShape().second + 1, l.getOutputSize());
+      offset += l.numParams();
+    }
+
+    //forward: R{outputs}, which for L2 is also R{loss_deriv}
+    Mat outR;
+    auto dit = dirs.begin();
+    for(auto& l : layers){
+      outR = l.forwardR(outR, *dit);
+      dit++;
+    }
+
+    Vec Hv(v.size());
+    Mat lossGrad = loss_deriv, lossGradR = outR;
+    offset = v.size();
+    auto rdit = dirs.rbegin();
+    for(auto l = layers.rbegin(); l != layers.rend(); l++, rdit++){
+      offset -= l->numParams();
+      Eigen::Map<Mat> gradR(Hv.data() + offset, rdit->rows(), rdit->cols());
+      lossGradR = l->backwardR(lossGrad, lossGradR, *rdit, gradR, gaussNewton);
+      if(std::next(l) != layers.rend()){
+	lossGrad = l->getInputGrad();
+      }
+    }
+    return Hv;
+  }
+
   void Network::setUpdateParams(const std::list<std::tuple<double,double>>& argsList)
   {
     if(argsList.size() != layers.size()){
@@ -115,6 +222,19 @@ namespace NN
     }
   }
 
+  void Network::setOptimizer(UpdateRule rule, const std::list<OptimizerParams>& paramsList)
+  {
+    if(paramsList.size() != layers.size()){
+      throw "Error: must provide exactly one OptimizerParams for each layer.";
+    }
+    update = rule;
+    auto pit = paramsList.begin();
+    for(auto& l : layers){
+      l.setOptimizer(rule, *pit);
+      std::advance(pit, 1);
+    }
+  }
+
   void Network::setActivations(const std::list<std::string>& activations)
   {
     if(activations.size() != layers.size()){
@@ -128,6 +248,17 @@ namespace NN
   }
 
 
+  Mat Network::forwardLayers(ConstMatRef data)
+  {
+    Mat layerOut = data;
+    for(auto& l : layers) {
+	l.forwardPass(layerOut);
+	//output of this layer is input to the next layer, then eventually the output
+	layerOut = l.getOutputs();
+    }
+    return layerOut;
+  }
+
   void Network::predict(std::optional<Mat> inputData,
 			std::optional<Vec> _target) 
   {
@@ -138,15 +269,7 @@ namespace NN
       setTarget(*_target);
     }
 			
-    Mat layerOut = inputs;
-    for(auto& l : layers) {
-	l.setInputs(layerOut);
-
-	l.forwardPass();
-	//output of this layer is input to the next layer, then eventually the output
-	layerOut = l.getOutputs();
-    }
-    outputs = layerOut;
+    outputs = forwardLayers(inputs);
 
     resid = outputs - target;
 
@@ -158,6 +281,26 @@ namespace NN
 
   Vec Network::predictVal(std::optional<Mat> inputData,
 			  std::optional<Vec> _target) 
+  {
+    predict(inputData, _target);
+    return outputs;
+  }
+
+
+  Mat Network::outputLayerFeatures(ConstMatRef data)
+  {
+    Mat layerOut = data;
+    for(auto l = layers.begin(); std::next(l) != layers.end(); l++){
+      l->forwardPass(layerOut);
+      layerOut = l->getOutputs();
+    }
+    return Layer::makeInputMat(layerOut);
+  }
+
+  void Network::solveOutputLayer(double lambda,
+				 int_t batchSize,
+				 std::optional<Mat> inputData,
+				 std::optional<Vec> _target)
   {
     if(inputData){
       setInputs(*inputData);
@@ -165,45 +308,108 @@ namespace NN
     if(_target){
       setTarget(*_target);
     }
-			
-    Mat layerOut = inputs;
-    for(auto& l : layers)
-      {
-	l.setInputs(layerOut);
-
-	l.forwardPass();
-	//output of this layer is input to the next layer, then eventually the output
-	layerOut = l.getOutputs();
-      }
-    outputs = layerOut;
-
-    resid = outputs - target;
+    if(target.size() != inputs.rows()){
+      throw "Error: need one target per input row to solve for the output layer.";
+    }
+    Layer& last = layers.back();
+    const int_t p = last.getInputShape().second + 1;
+    const int_t rows = inputs.rows();
+    const int_t bs = batchSize > 0 ? batchSize : rows;
+
+    Mat HtH = Mat::Zero(p, p);
+    Mat HtY = Mat::Zero(p, 1);
+    for(int_t start = 0; start < rows; start += bs){
+      const int_t m = std::min(bs, rows - start);
+      Mat H = outputLayerFeatures(inputs.middleRows(start, m));
+      Mat Y = last.invertActivation(target.segment(start, m));
+      HtH.selfadjointView<Eigen::Lower>().rankUpdate(H.transpose());
+      HtY.noalias() += H.transpose() * Y;
+    }
+    HtH.diagonal().array() += lambda;
+    Eigen::LLT<Mat> llt(HtH.selfadjointView<Eigen::Lower>());
+    if(llt.info() != Eigen::Success){
+      throw "Error: output layer normal equations are not positive definite; increase lambda.";
+    }
+    last.setWeights(llt.solve(HtY));
+    predict();
+  }
 
-    scalar_loss = vector_loss_func(outputs, target);
+  int_t Network::microBatchSize(size_t memoryBytes, int_t batchRows) const
+  {
+    const int_t perRow = activationBytesPerRow();
+    const int_t fit = static_cast<int_t>(memoryBytes / perRow);
+    if(fit < 1){
+      throw "Error: memory budget is smaller than the activations of one row.";
+    }
+    return std::min(fit, batchRows);
+  }
 
-    loss_deriv = vector_loss_derivative(outputs, target);
+  double Network::accumulateAndUpdate(ConstMatRef batchInputs, Eigen::Ref<const Vec> batchTarget,
+				      size_t memoryBytes)
+  {
+    const int_t rows = batchInputs.rows();
+    const int_t micro = microBatchSize(memoryBytes, rows);
+    if(micro == rows){
+      setBatch(batchInputs, batchTarget);
+      predict();
+      backwardPass();
+      updateWeights();
+      return scalar_loss;
+    }
 
-    return outputs;
+    std::vector<Mat> acc(layers.size());
+    double loss = 0.0;
+    for(int_t start = 0; start < rows; start += micro){
+      const int_t m = std::min(micro, rows - start);
+      setBatch(batchInputs.middleRows(start, m), batchTarget.segment(start, m));
+      predict();
+      backwardPass();
+      loss += scalar_loss;
+      size_t i = 0;
+      for(const auto& l : layers){
+	if(start == 0){
+	  acc[i] = l.getGradient();
+	} else {
+	  acc[i] += l.getGradient();
+	}
+	i++;
+      }
+    }
+    size_t i = 0;
+    for(auto& l : layers){
+      l.setGradient(acc[i]);
+      i++;
+    }
+    updateWeights();
+    scalar_loss = loss;
+    return loss;
   }
 
-
-  void Network::backwardPass()
+  void Network::backwardLayers(ConstMatRef outputGrad)
   {
-    //from the second-to-last layer, iterate to the beginning
-    bool isFirst = true;
-    auto prevLayer = layers.back();
+    //from the last layer, iterate to the beginning
+    const Layer* prevLayer = nullptr;
+    size_t index = layers.size();
     for(auto l=layers.rbegin(); l != layers.rend(); l++){
-      if(isFirst){
-	l->backwardPass(loss_deriv);
-	isFirst = false;
+      if(prevLayer == nullptr){
+	l->backwardPass(outputGrad);
       } else {
-	l->backwardPass(prevLayer);
+	l->backwardPass(*prevLayer);
+      }
+      prevLayer = &(*l);
+      index--;
+      if(gradientHook){
+	gradientHook(index, *l);
       }
-      prevLayer = *l;
     }
     gradient = layers.front().getGradient();  
   }
 
+  void Network::backwardPass()
+  {
+    backwardLayers(loss_deriv);
+  }
+
 
  
   void Network::train(double stopTol, 
@@ -219,7 +425,7 @@ namespace NN
     size_t num_iter = 1;
     updateWeights();
     //run until stopping criteria are hit
-    while(num_iter < maxIter and gradient.norm() > stopTol) {
+    while(num_iter < maxIter and getGradientNorm() > stopTol) {
       predict();
       backwardPass();
       trainingLoss.push_back(scalar_loss);
@@ -0,0 +1,344 @@
+#include <Optimizer.hpp>
+#include <cmath>
+
+
+namespace NN
+{
+
+  using int_t = int_fast64_t;
+
+  //what every kernel does to a weight after its rule: to the first nReg weights of the
+  //block (the bias row, if any, comes after them)
+  struct Regularizer
+  {
+    int_t nReg;
+
+    //global-norm clipping's factor on the gradient
+    double gradScale;
+
+    //coupled L2, added to the gradient
+    double l2;
+
+    //decoupled decay times Layer::updateWeights' mult
+    double shrink;
+
+    //L1 soft threshold lr * l1
+    double thresh;
+
+    //max-norm: sums of squares of the columns of the nReg weights as rows of cols entries
+    //(cols 0: one sum), or null
+    double* colSq;
+
+    int_t cols;
+  };
+
+  /*
+   * the one pass every kernel makes: newWeight(i, gi) advances weight i's optimizer state
+   * given its scaled gradient (plus l2 * w for regularized weights) and returns the rule's
+   * new weight, which is then shrunk, soft-thresholded, written, folded into the average
+   * and into its column's squared norm.
+   * */
+  template<class Rule>
+  static void sweep(Rule newWeight, const Regularizer& reg, double* __restrict w,
+		    const double* __restrict g, double* __restrict avg, double ac, int_t n)
+  {
+    const double gs = reg.gradScale, l2 = reg.l2, shrink = reg.shrink, thresh = reg.thresh;
+    auto regularized = [&](int_t i) {
+      const double wi = shrink * newWeight(i, gs * g[i] + l2 * w[i]);
+      const double a = std::abs(wi) - thresh;
+      return a > 0.0 ? std::copysign(a, wi) : 0.0;
+    };
+    if(reg.colSq and reg.cols > 0){
+      //row by row, so that each lane owns a column's sum
+      const int_t cols = reg.cols;
+      double* __restrict sq = reg.colSq;
+      for(int_t r = 0; r < reg.nReg / cols; r++){
+	#pragma omp simd
+	for(int_t j = 0; j < cols; j++){
+	  const int_t i = r * cols + j;
+	  const double wi = regularized(i);
+	  w[i] = wi;
+	  sq[j] += wi * wi;
+	  if(avg){
+	    avg[i] += ac * (wi - avg[i]);
+	  }
+	}
+      }
+    } else {
+      double sq = 0.0;
+      #pragma omp simd reduction(+:sq)
+      for(int_t i = 0; i < reg.nReg; i++){
+	const double wi = regularized(i);
+	w[i] = wi;
+	sq += wi * wi;
+	if(avg){
+	  avg[i] += ac * (wi - avg[i]);
+	}
+      }
+      if(reg.colSq){
+	reg.colSq[0] = sq;
+      }
+    }
+    #pragma omp simd
+    for(int_t i = reg.nReg; i < n; i++){
+      const double wi = newWeight(i, gs * g[i]);
+      w[i] = wi;
+      if(avg){
+	avg[i] += ac * (wi - avg[i]);
+      }
+    }
+  }
+
+  static void momentumKernel(double lr, double mu, double* __restrict w,
+			     const double* __restrict g, double* __restrict v,
+			     double* __restrict avg, double ac, const Regularizer& reg, int_t n)
+  {
+    sweep([=](int_t i, double gi) {
+	v[i] = mu * v[i] - lr * gi;
+	return w[i] + v[i];
+      }, reg, w, g, avg, ac, n);
+  }
+
+  //Nesterov in the form that only needs the current weights:
+  //w += -mu v_old + (1 + mu) v_new
+  static void nesterovKernel(double lr, double mu, double* __restrict w,
+			     const double* __restrict g, double* __restrict v,
+			     double* __restrict avg, double ac, const Regularizer& reg, int_t n)
+  {
+    sweep([=](int_t i, double gi) {
+	const double vOld = v[i];
+	const double vNew = mu * vOld - lr * gi;
+	v[i] = vNew;
+	return w[i] + (1.0 + mu) * vNew - mu * vOld;
+      }, reg, w, g, avg, ac, n);
+  }
+
+  //decay is the decoupled weight-decay factor lr * weightDecay (0 for plain Adam)
+  static void adamKernel(double lr, double b1, double b2, double eps, double decay,
+			 double c1, double c2, double* __restrict w, const double* __restrict g,
+			 double* __restrict m, double* __restrict v,
+			 double* __restrict avg, double ac, const Regularizer& reg, int_t n)
+  {
+    sweep([=](int_t i, double gi) {
+	const double mi = b1 * m[i] + (1.0 - b1) * gi;
+	const double vi = b2 * v[i] + (1.0 - b2) * gi * gi;
+	m[i] = mi;
+	v[i] = vi;
+	return w[i] - (lr * (c1 * mi) / (std::sqrt(c2 * vi) + eps) + decay * w[i]);
+      }, reg, w, g, avg, ac, n);
+  }
+
+  static void rmspropKernel(double lr, double rho, double mu, double eps,
+			    double* __restrict w, const double* __restrict g,
+			    double* __restrict buf, double* __restrict v,
+			    double* __restrict avg, double ac, const Regularizer& reg, int_t n)
+  {
+    sweep([=](int_t i, double gi) {
+	const double vi = rho * v[i] + (1.0 - rho) * gi * gi;
+	const double bi = mu * buf[i] + gi / (std::sqrt(vi) + eps);
+	v[i] = vi;
+	buf[i] = bi;
+	return w[i] - lr * bi;
+      }, reg, w, g, avg, ac, n);
+  }
+
+  static void adagradKernel(double lr, double eps, double* __restrict w,
+			    const double* __restrict g, double* __restrict v,
+			    double* __restrict avg, double ac, const Regularizer& reg, int_t n)
+  {
+    sweep([=](int_t i, double gi) {
+	const double vi = v[i] + gi * gi;
+	v[i] = vi;
+	return w[i] - lr * gi / (std::sqrt(vi) + eps);
+      }, reg, w, g, avg, ac, n);
+  }
+
+  //|w|/|u| with the usual fallback to 1 when either norm vanishes
+  static double trustRatio(double wNormSq, double uNormSq)
+  {
+    return (wNormSq > 0.0 and uNormSq > 0.0) ? std::sqrt(wNormSq / uNormSq) : 1.0;
+  }
+
+  static void larsKernel(double lr, double mu, double eta, double wd, double* __restrict w,
+			 const double* __restrict g, double* __restrict v,
+			 double* __restrict avg, double ac, const Regularizer& reg, int_t n)
+  {
+    double wSq = 0.0, gSq = 0.0;
+    const int_t nReg = reg.nReg;
+    const double gs = reg.gradScale, l2 = reg.l2;
+    #pragma omp simd reduction(+:wSq,gSq)
+    for(int_t i = 0; i < n; i++){
+      const double gi = gs * g[i] + (i < nReg ? l2 * w[i] : 0.0);
+      wSq += w[i] * w[i];
+      gSq += gi * gi;
+    }
+    //local rate eta |w| / (|g| + wd |w|)
+    const double wNorm = std::sqrt(wSq), gNorm = std::sqrt(gSq);
+    const double denom = gNorm + wd * wNorm;
+    const double local = (wNorm > 0.0 and denom > 0.0) ? eta * wNorm / denom : 1.0;
+    const double step = lr * local;
+    sweep([=](int_t i, double gi) {
+	v[i] = mu * v[i] - step * (gi + wd * w[i]);
+	return w[i] + v[i];
+      }, reg, w, g, avg, ac, n);
+  }
+
+  //the first pass updates the moments and takes the norms; the second recomputes the Adam
+  //direction from them instead of storing it
+  static void lambKernel(double lr, double b1, double b2, double eps, double wd,
+			 double c1, double c2, double* __restrict w, const double* __restrict g,
+			 double* __restrict m, double* __restrict v,
+			 double* __restrict avg, double ac, const Regularizer& reg, int_t n)
+  {
+    double wSq = 0.0, uSq = 0.0;
+    const int_t nReg = reg.nReg;
+    const double gs = reg.gradScale, l2 = reg.l2;
+    #pragma omp simd reduction(+:wSq,uSq)
+    for(int_t i = 0; i < n; i++){
+      const double gi = gs * g[i] + (i < nReg ? l2 * w[i] : 0.0);
+      const double mi = b1 * m[i] + (1.0 - b1) * gi;
+      const double vi = b2 * v[i] + (1.0 - b2) * gi * gi;
+      m[i] = mi;
+      v[i] = vi;
+      const double ui = (c1 * mi) / (std::sqrt(c2 * vi) + eps) + wd * w[i];
+      wSq += w[i] * w[i];
+      uSq += ui * ui;
+    }
+    const double step = lr * trustRatio(wSq, uSq);
+    sweep([=](int_t i, double) {
+	return w[i] - step * ((c1 * m[i]) / (std::sqrt(c2 * v[i]) + eps) + wd * w[i]);
+      }, reg, w, g, avg, ac, n);
+  }
+
+  void applyUpdate(UpdateRule rule, const OptimizerParams& params,
+		   double* weights, const double* gradient,
+		   OptimizerState& state, int_t n,
+		   int_t numRegularized, int_t cols, double mult, double gradScale)
+  {
+    if(state.moment1.size() != n){
+      state.moment1 = Eigen::VectorXd::Zero(n);
+      state.step = 0;
+    }
+    const bool needsMoment2 = rule == UpdateRule::Adam or rule == UpdateRule::AdamW
+      or rule == UpdateRule::RMSProp or rule == UpdateRule::AdaGrad or rule == UpdateRule::LAMB;
+    if(needsMoment2 and state.moment2.size() != n){
+      state.moment2 = Eigen::VectorXd::Zero(n);
+    }
+    state.step++;
+
+    //the kernels fold each new weight into the running average as soon as they write it;
+    //ac is the new weight's share (EMA: 1 - decay, SWA: 1 / count)
+    double* avg = nullptr;
+    double ac = 0.0;
+    if(params.averaging != Averaging::None){
+      if(state.average.size() != n){
+	//EMA starts from the current weights; SWA's first step overwrites them (ac = 1)
+	state.average = Eigen::Map<const AverageMat>(weights, n, 1);
+	state.numAveraged = 0;
+      }
+      if(params.averaging == Averaging::EMA){
+	if(params.emaDecay < 0.0 or params.emaDecay >= 1.0){
+	  throw "Error: emaDecay must be in [0, 1).";
+	}
+	avg = state.average.data();
+	ac = 1.0 - params.emaDecay;
+      } else {
+	if(params.swaStart < 1 or params.swaPeriod < 1){
+	  throw "Error: swaStart and swaPeriod must be positive.";
+	}
+	if(state.step >= params.swaStart and (state.step - params.swaStart) % params.swaPeriod == 0){
+	  avg = state.average.data();
+	  ac = 1.0 / static_cast<double>(++state.numAveraged);
+	}
+      }
+    }
+
+    const double lr = params.learningRate;
+    if(params.l2 < 0.0 or params.decoupledDecay < 0.0 or params.l1 < 0.0 or params.maxNorm < 0.0
+       or gradScale < 0.0){
+      throw "Error: regularization strengths and the gradient scale must be non-negative.";
+    }
+    Regularizer reg;
+    reg.nReg = (numRegularized < 0 or numRegularized > n) ? n : numRegularized;
+    reg.gradScale = gradScale;
+    reg.l2 = params.l2;
+    reg.shrink = mult * (1.0 - lr * params.decoupledDecay);
+    reg.thresh = lr * params.l1;
+    reg.cols = cols;
+    reg.colSq = nullptr;
+    if(params.maxNorm > 0.0){
+      if(cols < 0 or (cols > 0 and reg.nReg % cols != 0)){
+	throw "Error: maxNorm needs whole rows of cols weights.";
+      }
+      state.colNormSq.setZero(cols > 0 ? cols : 1);
+      reg.colSq = state.colNormSq.data();
+    }
+
+    switch(rule){
+    case UpdateRule::Momentum:
+      momentumKernel(lr, params.momentum, weights, gradient, state.moment1.data(),
+		     avg, ac, reg, n);
+      break;
+    case UpdateRule::NesterovAccGrad:
+      nesterovKernel(lr, params.momentum, weights, gradient, state.moment1.data(),
+		     avg, ac, reg, n);
+      break;
+    case UpdateRule::Adam:
+    case UpdateRule::AdamW:
+      {
+	//bias corrections for the first and second moments
+	const double c1 = 1.0 / (1.0 - std::pow(params.beta1, static_cast<double>(state.step)));
+	const double c2 = 1.0 / (1.0 - std::pow(params.beta2, static_cast<double>(state.step)));
+	const double decay = rule == UpdateRule::AdamW ? lr * params.weightDecay : 0.0;
+	adamKernel(lr, params.beta1, params.beta2, params.epsilon, decay, c1, c2,
+		   weights, gradient, state.moment1.data(), state.moment2.data(),
+		   avg, ac, reg, n);
+      }
+      break;
+    case UpdateRule::RMSProp:
+      rmspropKernel(lr, params.beta2, params.momentum, params.epsilon,
+		    weights, gradient, state.moment1.data(), state.moment2.data(),
+		    avg, ac, reg, n);
+      break;
+    case UpdateRule::AdaGrad:
+      adagradKernel(lr, params.epsilon, weights, gradient, state.moment2.data(),
+		    avg, ac, reg, n);
+      break;
+    case UpdateRule::LARS:
+      larsKernel(lr, params.momentum, params.trustCoefficient, params.weightDecay,
+		 weights, gradient, state.moment1.data(),
+		 avg, ac, reg, n);
+      break;
+    case UpdateRule::LAMB:
+      {
+	const double c1 = 1.0 / (1.0 - std::pow(params.beta1, static_cast<double>(state.step)));
+	const double c2 = 1.0 / (1.0 - std::pow(params.beta2, static_cast<double>(state.step)));
+	lambKernel(lr, params.beta1, params.beta2, params.epsilon, params.weightDecay, c1, c2,
+		   weights, gradient, state.moment1.data(), state.moment2.data(),
+		   avg, ac, reg, n);
+      }
+      break;
+    }
+
+    //max-norm: rescale the columns over the cap, and their share of the average with them
+    if(reg.colSq){
+      const int_t numCols = cols > 0 ? cols : 1, stride = cols > 0 ? cols : 1;
+      const int_t rows = cols > 0 ? reg.nReg / cols : reg.nReg;
+      const double capSq = params.maxNorm * params.maxNorm;
+      for(int_t j = 0; j < numCols; j++){
+	if(reg.colSq[j] <= capSq){
+	  continue;
+	}
+	const double s = params.maxNorm / std::sqrt(reg.colSq[j]);
+	for(int_t r = 0; r < rows; r++){
+	  const int_t i = r * stride + j;
+	  if(avg){
+	    avg[i] += ac * (s - 1.0) * weights[i];
+	  }
+	  weights[i] *= s;
+	}
+      }
+    }
+  }
+
+}//end namespace NN
@@ -0,0 +1,323 @@
+#include <ParameterServer.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <numeric>
+#include <random>
+#include <thread>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+
+namespace NN
+{
+
+  namespace
+  {
+
+    enum : std::uint32_t { Hello = 1, Pull, Push, Done, Weights };
+
+    struct Header
+    {
+      std::uint32_t type;
+
+      std::uint32_t worker;
+
+      //doubles following the header
+      std::int64_t count;
+    };
+
+    sockaddr_un socketAddress(const std::string& path)
+    {
+      sockaddr_un addr{};
+      if(path.size() >= sizeof(addr.sun_path)){
+	throw "Error: socket path too long.";
+      }
+      addr.sun_family = AF_UNIX;
+      std::strcpy(addr.sun_path, path.c_str());
+      return addr;
+    }
+
+    void writeAll(int fd, const void* buf, size_t bytes)
+    {
+      const char* p = static_cast<const char*>(buf);
+      while(bytes > 0){
+	const ssize_t n = send(fd, p, bytes, MSG_NOSIGNAL);
+	if(n < 0){
+	  throw "Error: parameter server connection lost while sending.";
+	}
+	p += n;
+	bytes -= n;
+      }
+    }
+
+    //false if the peer closed the connection before the first byte
+    bool readAll(int fd, void* buf, size_t bytes)
+    {
+      char* p = static_cast<char*>(buf);
+      const size_t total = bytes;
+      while(bytes > 0){
+	const ssize_t n = read(fd, p, bytes);
+	if(n == 0 and bytes == total){
+	  return false;
+	}
+	if(n <= 0){
+	  throw "Error: parameter server connection lost while receiving.";
+	}
+	p += n;
+	bytes -= n;
+      }
+      return true;
+    }
+
+  }//end anonymous namespace
+
+  ParameterServer::ParameterServer(const Network& net, const ParameterServerOptions& _opts) :
+    opts(_opts),
+    master(net),
+    clock(_opts.numWorkers, 0),
+    finished(_opts.numWorkers, false)
+  {
+    if(opts.numWorkers < 1 or opts.staleness < 0){
+      throw "Error: need at least one worker and a non-negative staleness bound.";
+    }
+    const sockaddr_un addr = socketAddress(opts.socketPath);
+    listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(opts.socketPath.c_str());
+    if(listenFd < 0 or bind(listenFd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0
+       or listen(listenFd, opts.numWorkers) != 0){
+      if(listenFd >= 0){
+	close(listenFd);
+	unlink(opts.socketPath.c_str());
+      }
+      throw "Error: parameter server could not listen on its socket.";
+    }
+  }
+
+  ParameterServer::~ParameterServer()
+  {
+    if(listenFd >= 0){
+      close(listenFd);
+      unlink(opts.socketPath.c_str());
+    }
+  }
+
+  int_t ParameterServer::minClock() const
+  {
+    int_t m = version + 1;
+    for(int w = 0; w < opts.numWorkers; w++){
+      if(not finished[w]){
+	m = std::min(m, clock[w]);
+      }
+    }
+    return m;
+  }
+
+  void ParameterServer::serve()
+  {
+    std::vector<pollfd> fds{{listenFd, POLLIN, 0}};
+    //worker id of each entry of fds (-1: the listener, or before Hello)
+    std::vector<int> fdWorker{-1};
+    std::vector<std::pair<int, int>> delayed;//(fd, worker) of held-back pulls
+    const int_t P = master.numParams();
+    Vec weights, grad(P);
+
+    auto answerPull = [&](int fd, int w) {
+      const int_t gap = clock[w] - minClock();
+      if(gap > opts.staleness){
+	return false;
+      }
+      maxServedGap = std::max(maxServedGap, gap);
+      weights = master.getFlatWeights();
+      const Header h{Weights, static_cast<std::uint32_t>(w), P};
+      writeAll(fd, &h, sizeof(h));
+      writeAll(fd, weights.data(), P * sizeof(double));
+      return true;
+    };
+    auto retryDelayed = [&]() {
+      delayed.erase(std::remove_if(delayed.begin(), delayed.end(), [&](const std::pair<int, int>& d) {
+	    return answerPull(d.first, d.second);
+	  }), delayed.end());
+    };
+
+    int numDone = 0;
+    while(numDone < opts.numWorkers){
+      if(poll(fds.data(), fds.size(), -1) < 0){
+	throw "Error: poll failed in the parameter server.";
+      }
+      if(fds[0].revents & POLLIN){
+	const int fd = accept(listenFd, nullptr, nullptr);
+	if(fd >= 0){
+	  fds.push_back({fd, POLLIN, 0});
+	  fdWorker.push_back(-1);
+	}
+      }
+      for(size_t i = 1; i < fds.size(); i++){
+	if(not (fds[i].revents & (POLLIN | POLLHUP | POLLERR))){
+	  continue;
+	}
+	Header h;
+	const bool open = readAll(fds[i].fd, &h, sizeof(h));
+	const int w = open ? static_cast<int>(h.worker) : fdWorker[i];
+	if(open and (w < 0 or w >= opts.numWorkers)){
+	  throw "Error: parameter server got a message from an unknown worker.";
+	}
+	if(open and h.type == Hello){
+	  fdWorker[i] = w;
+	} else if(open and h.type == Pull){
+	  if(not answerPull(fds[i].fd, w)){
+	    delayed.emplace_back(fds[i].fd, w);
+	    numDelayedPulls++;
+	  }
+	} else if(open and h.type == Push){
+	  if(h.count != P){
+	    throw "Error: pushed gradient does not match the server's network.";
+	  }
+	  if(not readAll(fds[i].fd, grad.data(), P * sizeof(double))){
+	    throw "Error: parameter server connection closed before the pushed gradient.";
+	  }
+	  int_t offset = 0;
+	  for(auto& l : master.getLayersRef()){
+	    const int_t rows = l.getInputShape().second + 1, cols = l.getOutputSize();
+	    l.setGradient(Eigen::Map<const Mat>(grad.data() + offset, rows, cols));
+	    offset += rows * cols;
+	  }
+	  master.updateWeights();
+	  version++;
+	  clock[w]++;
+	  retryDelayed();
+	} else if(open and h.type != Done){
+	  throw "Error: parameter server got a message of unknown type.";
+	} else {
+	  //Done, or the worker went away without saying so
+	  if(w < 0){
+	    //no way to tell which worker will never finish now
+	    throw "Error: a connection to the parameter server closed before saying hello.";
+	  }
+	  if(not finished[w]){
+	    finished[w] = true;
+	    numDone++;
+	  }
+	  //drop its held-back pulls before the fd number can be reused
+	  const int fd = fds[i].fd;
+	  delayed.erase(std::remove_if(delayed.begin(), delayed.end(), [fd](const std::pair<int, int>& d) {
+		return d.first == fd;
+	      }), delayed.end());
+	  close(fd);
+	  fds.erase(fds.begin() + i);
+	  fdWorker.erase(fdWorker.begin() + i);
+	  i--;
+	  retryDelayed();
+	}
+      }
+    }
+    for(size_t i = 1; i < fds.size(); i++){
+      close(fds[i].fd);
+    }
+  }
+
+  ParameterClient::ParameterClient(const std::string& socketPath, int _workerId, double timeoutSeconds) :
+    workerId(_workerId)
+  {
+    const sockaddr_un addr = socketAddress(socketPath);
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::duration<double>(timeoutSeconds);
+    while(true){
+      fd = socket(AF_UNIX, SOCK_STREAM, 0);
+      if(fd >= 0 and connect(fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) == 0){
+	break;
+      }
+      if(fd >= 0){
+	close(fd);
+	fd = -1;
+      }
+      if(std::chrono::steady_clock::now() > deadline){
+	throw "Error: could not connect to the parameter server.";
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    sendMessage(Hello, nullptr, 0);
+  }
+
+  ParameterClient::~ParameterClient()
+  {
+    if(fd >= 0){
+      close(fd);
+    }
+  }
+
+  void ParameterClient::sendMessage(std::uint32_t type, const double* data, std::int64_t count)
+  {
+    if(fd < 0){
+      throw "Error: this worker is done with the parameter server.";
+    }
+    const Header h{type, static_cast<std::uint32_t>(workerId), count};
+    writeAll(fd, &h, sizeof(h));
+    if(count > 0){
+      writeAll(fd, data, count * sizeof(double));
+    }
+  }
+
+  void ParameterClient::pull(Network& net)
+  {
+    sendMessage(Pull, nullptr, 0);
+    Header h;
+    if(not readAll(fd, &h, sizeof(h)) or h.type != Weights or h.count != net.numParams()){
+      throw "Error: bad weights message from the parameter server.";
+    }
+    Vec w(h.count);
+    readAll(fd, w.data(), h.count * sizeof(double));
+    net.setFlatWeights(w);
+  }
+
+  void ParameterClient::push(const Network& net)
+  {
+    const Vec g = net.getFlatGradient();
+    sendMessage(Push, g.data(), g.size());
+    clock++;
+  }
+
+  void ParameterClient::done()
+  {
+    sendMessage(Done, nullptr, 0);
+    close(fd);
+    fd = -1;
+  }
+
+  void ParameterClient::train(Network& net, ConstMatRef X, Eigen::Ref<const Vec> y, int_t batchSize,
+			      size_t epochs, unsigned seed)
+  {
+    const int_t n = X.rows();
+    if(y.size() != n){
+      throw "Error: need one target per data row.";
+    }
+    if(batchSize <= 0){
+      throw "Error: batch size must be positive.";
+    }
+    std::vector<int_t> rows(n);
+    std::iota(rows.begin(), rows.end(), 0);
+    std::mt19937_64 gen(seed);
+    Mat batchInputs;
+    Vec batchTarget;
+    for(size_t epoch = 0; epoch < epochs; epoch++){
+      std::shuffle(rows.begin(), rows.end(), gen);
+      for(int_t start = 0; start < n; start += batchSize){
+	const int_t m = std::min(batchSize, n - start);
+	batchInputs.resize(m, X.cols());
+	batchTarget.resize(m);
+	for(int_t j = 0; j < m; j++){
+	  batchInputs.row(j) = X.row(rows[start + j]);
+	  batchTarget[j] = y[rows[start + j]];
+	}
+	pull(net);
+	net.setBatch(batchInputs, batchTarget);
+	net.predict();
+	net.backwardPass();
+	push(net);
+      }
+    }
+    done();
+  }
+
+}//end namespace NN
@@ -0,0 +1,124 @@
+#include <PlapEnergy.hpp>
+
+
+namespace NN
+{
+
+  CollocationGrid CollocationGrid::structured(const Vec& lower, const Vec& upper,
+					      const std::vector<int_t>& counts)
+  {
+    const int_t dim = lower.size();
+    if(upper.size() != dim or static_cast<int_t>(counts.size()) != dim){
+      throw "Error: lower, upper and counts must have one entry per dimension.";
+    }
+    int_t total = 1;
+    for(auto n : counts){
+      if(n < 2){
+	throw "Error: need at least two grid points per dimension.";
+      }
+      total *= n;
+    }
+
+    CollocationGrid grid;
+    grid.points.resize(total, dim);
+    grid.weights = Vec::Ones(total);
+    for(int_t i = 0; i < total; i++){
+      //last dimension varies fastest
+      int_t rem = i;
+      for(int_t d = dim - 1; d >= 0; d--){
+	const int_t j = rem % counts[d];
+	rem /= counts[d];
+	const double h = (upper[d] - lower[d]) / (counts[d] - 1);
+	grid.points(i, d) = lower[d] + j * h;
+	grid.weights[i] *= (j == 0 or j == counts[d] - 1) ? 0.5 * h : h;
+      }
+    }
+    return grid;
+  }
+
+  //pushes the points and the identity tangents through the layers
+  static Mat forwardWithTangents(Network& net, const Mat& points, std::vector<Mat>& tangents)
+  {
+    const int_t dim = points.cols();
+    tangents.assign(dim, Mat::Zero(points.rows(), dim));
+    for(int_t k = 0; k < dim; k++){
+      tangents[k].col(k).setOnes();
+    }
+    Mat layerOut = points;
+    for(auto& l : net.getLayersRef()){
+      l.forwardTangents(layerOut, tangents);
+      layerOut = l.getOutputs();
+    }
+    if(layerOut.cols() != 1){
+      throw "Error: PlapEnergyLoss needs a network with a single output.";
+    }
+    return layerOut;
+  }
+
+  double PlapEnergyLoss::evaluate(Network& net)
+  {
+    std::vector<Mat> tangents;
+    u = forwardWithTangents(net, grid.points, tangents);
+
+    gradU.resize(grid.points.rows(), grid.points.cols());
+    for(size_t k = 0; k < tangents.size(); k++){
+      gradU.col(k) = tangents[k].col(0);
+    }
+
+    //sum_i w_i (|g_i|^p / p - f_i u_i), with |g|^p = (|g|^2)^(p/2)
+    Vec sq = gradU.rowwise().squaredNorm();
+    energy = (grid.weights.array()
+	      * (sq.array().pow(0.5 * p) / p - f.array() * u.array())).sum();
+    return energy;
+  }
+
+  double PlapEnergyLoss::evaluateWithGradient(Network& net)
+  {
+    std::vector<Mat> tangents;
+    u = forwardWithTangents(net, grid.points, tangents);
+
+    const int_t dim = grid.points.cols();
+    gradU.resize(grid.points.rows(), dim);
+    for(int_t k = 0; k < dim; k++){
+      gradU.col(k) = tangents[k].col(0);
+    }
+
+    //one pass for the energy and the quadrature-weighted factor w_i |g_i|^(p-2)
+    Vec sq = gradU.rowwise().squaredNorm();
+    Vec gp2 = (sq.array() > 0.0).select(sq.array().pow(0.5 * (p - 2.0)), 0.0);
+    energy = (grid.weights.array()
+	      * (sq.array() * gp2.array() / p - f.array() * u.array())).sum();
+    Vec wgp2 = grid.weights.cwiseProduct(gp2);
+
+    //dE/du = -w f, dE/d(grad u) = w |g|^(p-2) g
+    Mat outputGrad = -grid.weights.cwiseProduct(f);
+    for(int_t k = 0; k < dim; k++){
+      tangents[k] = wgp2.cwiseProduct(gradU.col(k));
+    }
+
+    auto& layers = net.getLayersRef();
+    const Layer* next = nullptr;
+    for(auto l = layers.rbegin(); l != layers.rend(); l++){
+      if(next == nullptr){
+	l->backwardTangents(outputGrad, tangents);
+      } else {
+	l->backwardTangents(next->getInputGrad(), tangents);
+      }
+      next = &(*l);
+    }
+    return energy;
+  }
+
+  void PlapEnergyLoss::train(Network& net, double stopTol, size_t maxIter)
+  {
+    for(size_t it = 0; it < maxIter; it++){
+      energyHistory.push_back(evaluateWithGradient(net));
+      //each backwardTangents took its layer's gradient norm
+      if(net.getGradientNorm() < stopTol){
+	break;
+      }
+      net.updateWeights();
+    }
+  }
+
+}//end namespace NN
@@ -0,0 +1,77 @@
+#include <PlapNetwork.hpp>
+
+
+namespace NN
+{
+
+  //out = a * r^e, with the common exponents special-cased and the rest as a * exp(e log r)
+  static void powerKernel(const Vec& r, double e, double a, Vec& out)
+  {
+    if(e == 0.0){
+      out.setConstant(r.size(), a);
+    } else if(e == 1.0){
+      out = a * r;
+    } else if(e == 0.5){
+      out = a * r.array().sqrt();
+    } else {
+      out = a * (e * r.array().log()).exp();
+    }
+  }
+
+  //d(a r^e)/dz = 2 a e r^(e-1) z; returns the factor multiplying z, taken as 0 at r = 0
+  static Vec derivativeFactor(const Vec& r, double e, double a)
+  {
+    Vec f;
+    powerKernel(r, e - 1.0, 2.0 * a * e, f);
+    return (r.array() > 0.0).select(f, 0.0);
+  }
+
+  void PlapFinalLayer::forwardPass()
+  {
+    sqNorms = inputs.rowwise().squaredNorm();
+    powerKernel(sqNorms, 0.5 * (p - 2.0), a, output);
+  }
+
+  Mat PlapFinalLayer::computeJacobian()
+  {
+    Jacobian = derivativeFactor(sqNorms, 0.5 * (p - 2.0), a).asDiagonal() * inputs;
+    return Jacobian;
+  }
+
+  void PlapFinalLayer::backwardPass(Eigen::Ref<const Vec> loss_grad)
+  {
+    if(loss_grad.size() != inputs.rows()){
+      throw "Error: loss_grad must have one entry per sample.";
+    }
+    Vec factor = derivativeFactor(sqNorms, 0.5 * (p - 2.0), a).cwiseProduct(loss_grad);
+    inputGrad = factor.asDiagonal() * inputs;
+  }
+
+
+  void PlapNetwork::predict(std::optional<Mat> inputData,
+			    std::optional<Vec> _target)
+  {
+    if(inputData){
+      setInputs(*inputData);
+    }
+    if(_target){
+      setTarget(*_target);
+    }
+
+    plapLayer.forwardPass(forwardLayers(inputs));
+    outputs = plapLayer.getOutput();
+
+    resid = outputs - target;
+
+    scalar_loss = vector_loss_func(outputs, target);
+
+    loss_deriv = vector_loss_derivative(outputs, target);
+  }
+
+  void PlapNetwork::backwardPass()
+  {
+    plapLayer.backwardPass(loss_deriv);
+    backwardLayers(plapLayer.getInputGrad());
+  }
+
+}//end namespace NN
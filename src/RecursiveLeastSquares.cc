@@ -0,0 +1,39 @@
+#include <RecursiveLeastSquares.hpp>
+
+
+namespace NN
+{
+
+  void RecursiveLeastSquares::update(Network& net, ConstMatRef batchInputs,
+				     Eigen::Ref<const Vec> batchTarget)
+  {
+    if(batchTarget.size() != batchInputs.rows()){
+      throw "Error: need one target per input row for a least-squares update.";
+    }
+    Layer& last = net.getLayersRef().back();
+    Mat H = net.outputLayerFeatures(batchInputs);
+    Mat Y = last.invertActivation(batchTarget);
+    const int_t p = H.cols();
+    if(P.rows() != p){
+      P = Mat::Identity(p, p) / lambda;
+      if(not warmStart){
+	last.setWeights(Mat::Zero(p, last.getOutputSize()));
+      }
+    }
+    Mat W = last.getWeights();
+
+    //gain K = P H^T (forgetting I + H P H^T)^-1
+    Mat PHt = P * H.transpose();
+    Mat S = H * PHt;
+    S.diagonal().array() += forgetting;
+    Eigen::LLT<Mat> llt(S);
+    Mat K = llt.solve(PHt.transpose()).transpose();
+
+    W.noalias() += K * (Y - H * W);
+    P.noalias() -= K * PHt.transpose();
+    P /= forgetting;
+    last.setWeights(W);
+    numSamples += H.rows();
+  }
+
+}//end namespace NN
@@ -0,0 +1,229 @@
+#include <TaoTrainer.hpp>
+#include <LBFGS.hpp>
+#include <cmath>
+
+#ifdef NN_HAVE_PETSC
+#include <petsctao.h>
+#if defined(PETSC_USE_COMPLEX)
+#error "TaoTrainer needs a real-valued PETSc build"
+#endif
+//PetscErrorCode became an enum, with PETSC_SUCCESS as an enumerator, in 3.19
+#if PETSC_VERSION_LT(3, 19, 0)
+#define PETSC_SUCCESS 0
+#endif
+#endif
+
+
+namespace NN
+{
+
+  bool TaoTrainer::havePetsc() noexcept
+  {
+#ifdef NN_HAVE_PETSC
+    return true;
+#else
+    return false;
+#endif
+  }
+
+#ifdef NN_HAVE_PETSC
+
+  namespace
+  {
+    struct TaoContext
+    {
+      Network* net;
+
+      std::vector<double>* lossHistory;
+
+      //base point and gradient of the matrix-free Hessian
+      NN::Vec hessPoint, hessGrad, scratch;
+    };
+
+    //TAO objective and gradient, read and written in place through the Vec arrays
+    PetscErrorCode formFunctionGradient(Tao, ::Vec X, PetscReal* f, ::Vec G, void* vctx)
+    {
+      auto* ctx = static_cast<TaoContext*>(vctx);
+      const PetscScalar* x;
+      PetscScalar* g;
+      PetscInt n;
+      PetscCall(VecGetLocalSize(X, &n));
+      PetscCall(VecGetArrayRead(X, &x));
+      PetscCall(VecGetArray(G, &g));
+      Eigen::Map<const NN::Vec> xmap(x, n);
+      Eigen::Map<NN::Vec> gmap(g, n);
+      const char* error = nullptr;
+      try {
+	*f = ctx->net->lossAndGradient(xmap, gmap);
+      } catch(const char* msg) {
+	error = msg;
+      }
+      //give the arrays back before raising, so G and X are usable again
+      PetscCall(VecRestoreArray(G, &g));
+      PetscCall(VecRestoreArrayRead(X, &x));
+      if(error){
+	SETERRQ(PETSC_COMM_SELF, PETSC_ERR_USER, "%s", error);
+      }
+      return PETSC_SUCCESS;
+    }
+
+    //Hessian-vector product by a forward difference of gradients around the last Hessian point
+    PetscErrorCode hessianMult(::Mat H, ::Vec V, ::Vec Y)
+    {
+      TaoContext* ctx;
+      PetscCall(MatShellGetContext(H, &ctx));
+      const PetscScalar* v;
+      PetscScalar* y;
+      PetscInt n;
+      PetscCall(VecGetLocalSize(V, &n));
+      PetscCall(VecGetArrayRead(V, &v));
+      PetscCall(VecGetArray(Y, &y));
+      Eigen::Map<const NN::Vec> vmap(v, n);
+      const double vnorm = vmap.norm();
+      Eigen::Map<NN::Vec> ymap(y, n);
+      const char* error = nullptr;
+      if(vnorm == 0.0){
+	ymap.setZero();
+      } else {
+	const double eps = std::sqrt(1.0e-16) * (1.0 + ctx->hessPoint.norm()) / vnorm;
+	ctx->scratch = ctx->hessPoint + eps * vmap;
+	NN::Vec gEps(n);
+	//no exception may unwind through PETSc's frames
+	try {
+	  ctx->net->lossAndGradient(ctx->scratch, gEps);
+	  ymap = (gEps - ctx->hessGrad) / eps;
+	} catch(const char* msg) {
+	  error = msg;
+	}
+      }
+      PetscCall(VecRestoreArray(Y, &y));
+      PetscCall(VecRestoreArrayRead(V, &v));
+      if(error){
+	SETERRQ(PETSC_COMM_SELF, PETSC_ERR_USER, "%s", error);
+      }
+      return PETSC_SUCCESS;
+    }
+
+    PetscErrorCode formHessian(Tao, ::Vec X, ::Mat, ::Mat, void* vctx)
+    {
+      auto* ctx = static_cast<TaoContext*>(vctx);
+      const PetscScalar* x;
+      PetscInt n;
+      PetscCall(VecGetLocalSize(X, &n));
+      PetscCall(VecGetArrayRead(X, &x));
+      ctx->hessPoint = Eigen::Map<const NN::Vec>(x, n);
+      ctx->hessGrad.resize(n);
+      const char* error = nullptr;
+      try {
+	ctx->net->lossAndGradient(ctx->hessPoint, ctx->hessGrad);
+      } catch(const char* msg) {
+	error = msg;
+      }
+      PetscCall(VecRestoreArrayRead(X, &x));
+      if(error){
+	SETERRQ(PETSC_COMM_SELF, PETSC_ERR_USER, "%s", error);
+      }
+      return PETSC_SUCCESS;
+    }
+
+    PetscErrorCode recordLoss(Tao tao, void* vctx)
+    {
+      auto* ctx = static_cast<TaoContext*>(vctx);
+      PetscInt its;
+      PetscReal f, gnorm, cnorm, xdiff;
+      TaoConvergedReason reason;
+      PetscCall(TaoGetSolutionStatus(tao, &its, &f, &gnorm, &cnorm, &xdiff, &reason));
+      ctx->lossHistory->push_back(f);
+      return PETSC_SUCCESS;
+    }
+  }
+
+  bool TaoTrainer::train(Network& net,
+			 std::optional<Mat> inputData,
+			 std::optional<Vec> target,
+			 bool noprint)
+  {
+    net.predict(inputData, target);
+    params = net.getFlatWeights();
+    const PetscInt n = params.size();
+
+    PetscBool initialized;
+    PetscCallAbort(PETSC_COMM_SELF, PetscInitialized(&initialized));
+    if(not initialized){
+      PetscCallAbort(PETSC_COMM_SELF, PetscInitializeNoArguments());
+    }
+
+    TaoContext ctx{&net, &lossHistory, NN::Vec(), NN::Vec(), NN::Vec()};
+
+    //the solution Vec shares params' storage
+    ::Vec X;
+    ::Mat H;
+    Tao tao;
+    PetscCallAbort(PETSC_COMM_SELF, VecCreateSeqWithArray(PETSC_COMM_SELF, 1, n, params.data(), &X));
+    PetscCallAbort(PETSC_COMM_SELF, MatCreateShell(PETSC_COMM_SELF, n, n, n, n, &ctx, &H));
+    PetscCallAbort(PETSC_COMM_SELF, MatShellSetOperation(H, MATOP_MULT, (void (*)(void))hessianMult));
+    PetscCallAbort(PETSC_COMM_SELF, MatSetOption(H, MAT_SYMMETRIC, PETSC_TRUE));
+
+    PetscCallAbort(PETSC_COMM_SELF, TaoCreate(PETSC_COMM_SELF, &tao));
+    PetscCallAbort(PETSC_COMM_SELF, TaoSetType(tao, opts.type.c_str()));
+    PetscCallAbort(PETSC_COMM_SELF, TaoSetSolution(tao, X));
+    PetscCallAbort(PETSC_COMM_SELF, TaoSetObjectiveAndGradient(tao, NULL, formFunctionGradient, &ctx));
+    PetscCallAbort(PETSC_COMM_SELF, TaoSetHessian(tao, H, H, formHessian, &ctx));
+    PetscCallAbort(PETSC_COMM_SELF, TaoSetTolerances(tao, opts.gatol, opts.grtol, 0.0));
+    PetscCallAbort(PETSC_COMM_SELF, TaoSetMaximumIterations(tao, opts.maxIter));
+#if PETSC_VERSION_LT(3, 21, 0)
+    PetscCallAbort(PETSC_COMM_SELF, TaoSetMonitor(tao, recordLoss, &ctx, NULL));
+#else
+    PetscCallAbort(PETSC_COMM_SELF, TaoMonitorSet(tao, recordLoss, &ctx, NULL));
+#endif
+    if(opts.monitor){
+      PetscCallAbort(PETSC_COMM_SELF, PetscOptionsSetValue(NULL, "-tao_monitor", NULL));
+    }
+    if(opts.fromOptions or opts.monitor){
+      PetscCallAbort(PETSC_COMM_SELF, TaoSetFromOptions(tao));
+    }
+
+    PetscCallAbort(PETSC_COMM_SELF, TaoSolve(tao));
+
+    TaoConvergedReason reason;
+    PetscCallAbort(PETSC_COMM_SELF, TaoGetConvergedReason(tao, &reason));
+    convergedReason = TaoConvergedReasons[reason];
+
+    PetscCallAbort(PETSC_COMM_SELF, TaoDestroy(&tao));
+    PetscCallAbort(PETSC_COMM_SELF, MatDestroy(&H));
+    PetscCallAbort(PETSC_COMM_SELF, VecDestroy(&X));
+
+    net.setFlatWeights(params);
+    net.predict();
+    const bool converged = reason > 0;
+    if(not converged and not noprint){
+      std::cout << "WARNING: TAO DID NOT CONVERGE (" << convergedReason << "). SCALAR LOSS IS "
+		<< net.getScalarLoss() << ". \n";
+    }
+    return converged;
+  }
+
+#else
+
+  bool TaoTrainer::train(Network& net,
+			 std::optional<Mat> inputData,
+			 std::optional<Vec> target,
+			 bool noprint)
+  {
+    if(not noprint){
+      std::cout << "NOTE: built without PETSc; TaoTrainer is using the built-in L-BFGS.\n";
+    }
+    LBFGSOptions lopts;
+    lopts.gradTol = opts.gatol;
+    lopts.maxIter = opts.maxIter;
+    LBFGSTrainer lbfgs(lopts);
+    const bool converged = lbfgs.train(net, inputData, target, noprint);
+    lossHistory = lbfgs.getLossHistory();
+    params = net.getFlatWeights();
+    convergedReason = converged ? "CONVERGED_GATOL" : "DIVERGED_MAXITS";
+    return converged;
+  }
+
+#endif
+
+}//end namespace NN
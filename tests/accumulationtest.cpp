@@ -0,0 +1,66 @@
+#include "../include/MiniBatch.hpp"
+#include "../include/Network.hpp"
+#include "../include/Layer.hpp"
+#include <Eigen/Core>
+#include <iostream>
+#include <cmath>
+
+using Mat = NN::Mat;
+using Vec = NN::Vec;
+
+int main(){
+	bool ok = true;
+
+	const int N = 1000;
+	Mat X = Mat::Random(N, 8);
+	Vec y = X.rowwise().sum().array().sin();
+	NN::Layer l1(std::make_pair(N, 8), 64, "tanh");
+	NN::Layer l2(std::make_pair(N, 64), 32, "tanh");
+	NN::Layer l3(std::make_pair(N, 32), 1, "linear");
+	NN::Network base("tanh", "L2", {l1, l2, l3});
+	base.getLayersRef().back().setActivation("linear");
+	base.setInputs(X);
+	base.setTarget(y, true);
+	NN::OptimizerParams sgd;
+	sgd.learningRate = 1.0e-4;
+	sgd.momentum = 0.9;
+	base.setOptimizer(NN::UpdateRule::Momentum, sgd);
+
+	//a budget of about 100 rows of activations
+	const size_t budget = 100 * base.activationBytesPerRow() + 17;
+	const auto micro = base.microBatchSize(budget, N);
+	std::cout << base.activationBytesPerRow() << " bytes of activations per row; "
+		  << "micro-batch of " << micro << " rows under a " << budget << " byte budget\n";
+	ok = ok and micro == 100;
+
+	//one accumulated step over the whole batch equals one full-batch step
+	NN::Network full = base, accum = base;
+	full.setBatch(X, y);
+	full.predict();
+	full.backwardPass();
+	full.updateWeights();
+	const double accLoss = accum.accumulateAndUpdate(X, y, budget);
+	const double wDiff = (full.getFlatWeights() - accum.getFlatWeights()).cwiseAbs().maxCoeff();
+	std::cout << "loss full batch " << full.getScalarLoss() << ", accumulated " << accLoss
+		  << "; max weight difference after the step " << wDiff << '\n';
+	ok = ok and std::abs(accLoss - full.getScalarLoss()) < 1.0e-9 * full.getScalarLoss() and wDiff < 1.0e-12;
+
+	//a logical batch of 500 under the budget trains the same as without it
+	NN::MiniBatchOptions opts;
+	opts.batchSize = 500;
+	opts.epochs = 3;
+	NN::Network capped = base, uncapped = base;
+	NN::MiniBatchTrainer mbUncapped(opts);
+	mbUncapped.train(uncapped, X, y, true);
+	opts.memoryBudget = budget;
+	NN::MiniBatchTrainer mbCapped(opts);
+	mbCapped.train(capped, X, y, true);
+	const double trainDiff = (capped.getFlatWeights() - uncapped.getFlatWeights()).cwiseAbs().maxCoeff();
+	std::cout << "mini-batch training with and without the cap: epoch loss "
+		  << mbCapped.getEpochLoss().back() << " vs. " << mbUncapped.getEpochLoss().back()
+		  << ", max weight difference " << trainDiff << '\n';
+	ok = ok and trainDiff < 1.0e-10;
+
+	std::cout << (ok ? "PASSED\n" : "FAILED\n");
+	return ok ? 0 : 1;
+}
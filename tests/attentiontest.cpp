@@ -0,0 +1,89 @@
+#include "../include/AttentionLayer.hpp"
+#include <Eigen/Core>
+#include <iostream>
+#include <cmath>
+
+using Mat = NN::Mat;
+
+//dense reference: materializes the full N x N score matrix
+Mat naiveAttention(const Mat& X, const Mat& Wq, const Mat& Wk, const Mat& Wv,
+		   const Mat& Wo, int heads, bool causal)
+{
+	Mat Xa = NN::Layer::makeInputMat(X);
+	Mat Q = Xa * Wq, K = Xa * Wk, V = Xa * Wv;
+	int d = X.cols(), hd = d / heads;
+	Mat A(X.rows(), d);
+	for(int h = 0; h < heads; h++){
+		Mat S = Q.middleCols(h*hd, hd) * K.middleCols(h*hd, hd).transpose() / std::sqrt(double(hd));
+		for(int r = 0; r < S.rows(); r++){
+			if(causal){
+				for(int c = r+1; c < S.cols(); c++){
+					S(r,c) = -1.0e300;
+				}
+			}
+			S.row(r) = (S.row(r).array() - S.row(r).maxCoeff()).exp();
+			S.row(r) /= S.row(r).sum();
+		}
+		A.middleCols(h*hd, hd) = S * V.middleCols(h*hd, hd);
+	}
+	return NN::Layer::makeInputMat(A) * Wo;
+}
+
+int main(){
+	const int N = 37, d = 8, heads = 2;
+	bool ok = true;
+
+	for(bool causal : {false, true}){
+		//block size deliberately does not divide N
+		NN::AttentionLayer attn(d, heads, 5, causal);
+		Mat X = Mat::Random(N, d);
+
+		attn.forwardPass(X);
+		auto [Wq, Wk, Wv, Wo] = attn.getWeights();
+		Mat ref = naiveAttention(X, Wq, Wk, Wv, Wo, heads, causal);
+		double fwdErr = (attn.getOutputs() - ref).cwiseAbs().maxCoeff();
+		std::cout << (causal ? "causal" : "full") << " forward max error vs. dense: " << fwdErr << '\n';
+		ok = ok and fwdErr < 1.0e-12;
+
+		//loss = 0.5 ||Y||^2, so dL/dY = Y
+		Mat Y = attn.getOutputs();
+		attn.backwardPass(Y);
+		auto grads = attn.getGradient();
+		Mat dX = attn.getInputGrad();
+
+		auto loss = [&](const Mat& Xin, const Mat& q) {
+			Mat out = naiveAttention(Xin, q, Wk, Wv, Wo, heads, causal);
+			return 0.5 * out.squaredNorm();
+		};
+
+		const double h = 1.0e-6;
+		double gradErr = 0.0;
+		for(int k = 0; k < 5; k++){
+			int r = k % (d+1), c = (3*k) % d;
+			Mat qp = Wq, qm = Wq;
+			qp(r,c) += h;
+			qm(r,c) -= h;
+			double fd = (loss(X, qp) - loss(X, qm)) / (2*h);
+			gradErr = std::max(gradErr, std::abs(fd - std::get<0>(grads)(r,c)));
+
+			int xr = (7*k) % N, xc = k % d;
+			Mat xp = X, xm = X;
+			xp(xr,xc) += h;
+			xm(xr,xc) -= h;
+			fd = (loss(xp, Wq) - loss(xm, Wq)) / (2*h);
+			gradErr = std::max(gradErr, std::abs(fd - dX(xr,xc)));
+		}
+		std::cout << (causal ? "causal" : "full") << " backward max error vs. finite differences: " << gradErr << '\n';
+		ok = ok and gradErr < 1.0e-5;
+	}
+
+	//long sequence: only O(N) state is kept
+	NN::AttentionLayer big(32, 4, 128);
+	Mat Xbig = Mat::Random(4096, 32);
+	big.forwardPass(Xbig);
+	big.backwardPass(big.getOutputs());
+	std::cout << "N = 4096 output norm: " << big.getOutputs().norm() << '\n';
+
+	std::cout << (ok ? "PASSED\n" : "FAILED\n");
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,118 @@
+#include "../include/GradientCompression.hpp"
+#include "../include/Network.hpp"
+#include "../include/Layer.hpp"
+#include <Eigen/Core>
+#include <iostream>
+#include <vector>
+#include <cmath>
+
+using Mat = NN::Mat;
+using Vec = NN::Vec;
+
+//data-parallel training with 4 simulated workers, each compressing its own shard's gradient
+double train(const NN::Network& base, const Mat& X, const Vec& y,
+	     const NN::CompressionOptions& copts, double& ratio){
+	const int W = 4, steps = 1000;
+	NN::Network net = base;
+	std::vector<NN::GradientCompressor> workers(W, NN::GradientCompressor(copts));
+	std::vector<std::vector<Mat>> grads(W);
+	const int_fast64_t n = X.rows() / W;
+	for(int s = 0; s < steps; s++){
+		auto& layers = net.getLayersRef();
+		for(int w = 0; w < W; w++){
+			net.setBatch(X.middleRows(w * n, n), y.segment(w * n, n));
+			net.predict();
+			net.backwardPass();
+			grads[w].clear();
+			for(const auto& l : layers){
+				grads[w].push_back(l.getGradient());
+			}
+		}
+		size_t i = 0;
+		for(auto& l : layers){
+			const Mat& g = grads[0][i];
+			Mat sum = Mat::Zero(g.rows(), g.cols());
+			if(workers[0].lowRank(g.rows(), g.cols())){
+				const int_fast64_t r = copts.rank;
+				Mat P = Mat::Zero(g.rows(), r), Pw(g.rows(), r), Q = Mat::Zero(g.cols(), r), Qw(g.cols(), r);
+				for(int w = 0; w < W; w++){
+					workers[w].lowRankP(i, grads[w][i], Pw);
+					P += Pw;
+				}
+				//every worker orthonormalizes its own copy of the summed P
+				Mat Pw0;
+				for(int w = 0; w < W; w++){
+					Pw0 = P;
+					workers[w].lowRankQ(i, Pw0, Qw);
+					Q += Qw;
+				}
+				for(int w = 0; w < W; w++){
+					workers[w].lowRankFinish(i, Pw0, Q, W, sum);
+				}
+			} else {
+				std::vector<unsigned char> payload(workers[0].payloadBytes(g.rows(), g.cols()));
+				for(int w = 0; w < W; w++){
+					workers[w].encode(i, grads[w][i], payload.data());
+					workers[0].decodeAdd(payload.data(), sum);
+				}
+			}
+			l.setGradient(sum);
+			i++;
+		}
+		net.updateWeights();
+	}
+	ratio = workers[0].compressionRatio();
+	net.setBatch(X, y);
+	net.predict();
+	return net.getScalarLoss() / X.rows();
+}
+
+int main(){
+	bool ok = true;
+
+	const int N = 400;
+	Mat X = Mat::Random(N, 10);
+	Vec y = (X.leftCols(5).rowwise().sum() - X.rightCols(5).rowwise().sum()).array().sin();
+	NN::Layer l1(std::make_pair(N, 10), 32, "tanh");
+	NN::Layer l2(std::make_pair(N, 32), 32, "tanh");
+	NN::Layer l3(std::make_pair(N, 32), 1, "linear");
+	NN::Network base("tanh", "L2", {l1, l2, l3});
+	base.getLayersRef().back().setActivation("linear");
+	base.setInputs(X);
+	base.setTarget(y, true);
+	NN::OptimizerParams sgd;
+	sgd.learningRate = 2.0e-4;
+	sgd.momentum = 0.0;
+	base.setOptimizer(NN::UpdateRule::Momentum, sgd);
+	base.predict();
+	const double initial = base.getScalarLoss() / N;
+
+	double ratio;
+	NN::CompressionOptions copts;
+	const double dense = train(base, X, y, copts, ratio);
+	std::cout << "initial loss " << initial << ", uncompressed " << dense << '\n';
+
+	//each method with error feedback: loss within 2x of uncompressed with many fewer bytes
+	//(PowerSGD gains more on wider layers)
+	for(auto [method, name, minRatio] : {std::make_tuple(NN::Compression::TopK, "top-1%", 50.0),
+					     std::make_tuple(NN::Compression::Int8, "8-bit", 7.9),
+					     std::make_tuple(NN::Compression::Sign, "1-bit", 50.0),
+					     std::make_tuple(NN::Compression::PowerSGD, "PowerSGD rank 2", 5.0)}){
+		copts.method = method;
+		copts.errorFeedback = true;
+		const double ef = train(base, X, y, copts, ratio);
+		copts.errorFeedback = false;
+		double unused;
+		const double noef = train(base, X, y, copts, unused);
+		std::cout << name << ": " << ratio << "x fewer bytes, loss " << ef
+			  << " with error feedback, " << noef << " without\n";
+		ok = ok and ratio >= minRatio and ef < 2.0 * dense + 1.0e-3 and ef < 0.2 * initial;
+		//8 bits lose too little for the feedback to matter
+		if(method != NN::Compression::Int8){
+			ok = ok and ef < noef;
+		}
+	}
+
+	std::cout << (ok ? "PASSED\n" : "FAILED\n");
+	return ok ? 0 : 1;
+}
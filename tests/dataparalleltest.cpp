@@ -0,0 +1,90 @@
+#include "../include/DataParallel.hpp"
+#include "../include/MiniBatch.hpp"
+#include "../include/Network.hpp"
+#include "../include/Layer.hpp"
+#include <Eigen/Core>
+#include <iostream>
+#include <cmath>
+
+using Mat = NN::Mat;
+using Vec = NN::Vec;
+
+int main(){
+	bool ok = true;
+
+	const int N = 1000;
+	Mat X = Mat::Random(N, 6);
+	Vec y = X.rowwise().sum().array().sin();
+	NN::Layer l1(std::make_pair(N, 6), 32, "tanh");
+	NN::Layer l2(std::make_pair(N, 32), 16, "tanh");
+	NN::Layer l3(std::make_pair(N, 16), 1, "linear");
+	NN::Network base("tanh", "L2", {l1, l2, l3});
+	base.getLayersRef().back().setActivation("linear");
+	base.setInputs(X);
+	base.setTarget(y, true);
+	NN::OptimizerParams sgd;
+	sgd.learningRate = 1.0e-3;
+	sgd.momentum = 0.9;
+	base.setOptimizer(NN::UpdateRule::Momentum, sgd);
+
+	//one step on 5 threads (an uneven tree) against the serial full-batch step
+	NN::Network serial = base, parallel = base;
+	serial.setBatch(X, y);
+	serial.predict();
+	serial.backwardPass();
+	serial.updateWeights();
+	NN::DataParallelTrainer dp(5);
+	const double loss = dp.step(parallel, X, y);
+	const double wDiff = (serial.getFlatWeights() - parallel.getFlatWeights()).cwiseAbs().maxCoeff();
+	std::cout << "5 threads: loss " << loss << " vs. serial " << serial.getScalarLoss()
+		  << ", max weight difference after one step " << wDiff << '\n';
+	ok = ok and std::abs(loss - serial.getScalarLoss()) < 1.0e-10 * loss and wDiff < 1.0e-13;
+
+	//a loss that throws in every worker: step() rethrows, leaves the network alone, and the
+	//pool is still usable afterwards
+	NN::Network broken = base;
+	broken.setLossFunc([](Vec, Vec) -> double { throw "Error: bad loss."; },
+			   [](Vec o, Vec) -> Vec { return o; });
+	bool threw = false;
+	try{
+		dp.step(broken, X, y);
+	} catch(const char*){
+		threw = true;
+	}
+	const bool untouched = broken.getFlatWeights() == base.getFlatWeights();
+
+	//the same depth with other widths gets fresh replicas
+	NN::Layer m1(std::make_pair(N, 6), 8, "tanh");
+	NN::Layer m2(std::make_pair(N, 8), 4, "sigmoid");
+	NN::Layer m3(std::make_pair(N, 4), 1, "linear");
+	NN::Network narrow("tanh", "L2", {m1, m2, m3});
+	narrow.getLayersRef().back().setActivation("linear");
+	narrow.setOptimizer(NN::UpdateRule::Momentum, sgd);
+	NN::Network narrowSerial = narrow;
+	narrowSerial.setBatch(X, y);
+	narrowSerial.predict();
+	narrowSerial.backwardPass();
+	narrowSerial.updateWeights();
+	dp.step(narrow, X, y);
+	const double nDiff = (narrowSerial.getFlatWeights() - narrow.getFlatWeights()).cwiseAbs().maxCoeff();
+	std::cout << "worker exception rethrown: " << threw << ", weights untouched: " << untouched
+		  << ", then another network of the same depth: max weight difference " << nDiff << '\n';
+	ok = ok and threw and untouched and nDiff < 1.0e-13;
+
+	//mini-batch training on 4 threads, twice: bit-identical weights
+	NN::MiniBatchOptions opts;
+	opts.batchSize = 100;
+	opts.epochs = 20;
+	opts.numThreads = 4;
+	NN::Network a = base, b = base;
+	NN::MiniBatchTrainer ta(opts), tb(opts);
+	ta.train(a, X, y, true);
+	tb.train(b, X, y, true);
+	const bool identical = a.getFlatWeights() == b.getFlatWeights();
+	std::cout << "4-thread training: epoch loss " << ta.getEpochLoss().front() << " -> "
+		  << ta.getEpochLoss().back() << ", repeated run bit-identical " << identical << '\n';
+	ok = ok and identical and ta.getEpochLoss().back() < 0.05 * ta.getEpochLoss().front();
+
+	std::cout << (ok ? "PASSED\n" : "FAILED\n");
+	return ok ? 0 : 1;
+}
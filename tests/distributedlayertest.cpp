@@ -0,0 +1,87 @@
+#include "../include/DistributedLayer.hpp"
+#include "../include/Layer.hpp"
+#include <Eigen/Core>
+#include <petscmat.h>
+#include <iostream>
+
+//PETSc has its own global Mat
+using DMat = NN::Mat;
+
+//run with e.g. mpirun -np 4 ./dltest
+int main(int argc, char** argv){
+	PetscCall(PetscInitialize(&argc, &argv, NULL, NULL));
+	int rank, size;
+	MPI_Comm_rank(PETSC_COMM_WORLD, &rank);
+	MPI_Comm_size(PETSC_COMM_WORLD, &size);
+	bool ok = true;
+	{
+		//every rank builds the same data and keeps rows rank, rank + size, ...
+		const int N = 64, D = 200, H = 32;
+		std::srand(5);
+		DMat X = DMat::Random(N, D);
+		DMat y = X.rowwise().sum().array().sin().matrix();
+		const int n = (N - rank + size - 1) / size;
+		DMat Xl(n, D), yl(n, 1);
+		for(int i = 0; i < n; i++){
+			Xl.row(i) = X.row(rank + i * size);
+			yl.row(i) = y.row(rank + i * size);
+		}
+
+		NN::OptimizerParams sgd;
+		sgd.learningRate = 1.0e-3;
+		sgd.momentum = 0.9;
+
+		//a distributed tanh layer feeding a replicated single-node linear layer
+		NN::DistributedLayer dl(PETSC_COMM_WORLD, D, H, "tanh");
+		dl.setOptimizer(NN::UpdateRule::Momentum, sgd);
+		NN::Layer head(std::make_pair(n, H), 1, "linear");
+		DMat hw = head.getWeights();
+		MPI_Bcast(hw.data(), hw.size(), MPI_DOUBLE, 0, PETSC_COMM_WORLD);
+		head.setWeights(hw);
+		head.setOptimizer(NN::UpdateRule::Momentum, sgd);
+
+		//the same network on one rank
+		NN::Layer s1(std::make_pair(N, D), H, "tanh"), s2(std::make_pair(N, H), 1, "linear");
+		s1.setWeights(dl.getWeights());
+		s2.setWeights(hw);
+		s1.setOptimizer(NN::UpdateRule::Momentum, sgd);
+		s2.setOptimizer(NN::UpdateRule::Momentum, sgd);
+
+		for(int it = 0; it < 5; it++){
+			dl.forwardPass(Xl);
+			head.forwardPass(dl.getOutputs());
+			head.backwardPass(head.getOutputs() - yl);
+			dl.backwardPass(head.getInputGrad());
+			//the replicated layer's gradient is summed over the ranks' rows
+			DMat g = head.getGradient();
+			MPI_Allreduce(MPI_IN_PLACE, g.data(), g.size(), MPI_DOUBLE, MPI_SUM, PETSC_COMM_WORLD);
+			head.setGradient(g);
+			dl.updateWeights();
+			head.updateWeights();
+
+			s1.forwardPass(X);
+			s2.forwardPass(s1.getOutputs());
+			s2.backwardPass(s2.getOutputs() - y);
+			s1.backwardPass(s2);
+			s1.updateWeights();
+			s2.updateWeights();
+		}
+
+		const double diff = std::max((dl.getWeights() - s1.getWeights()).cwiseAbs().maxCoeff(),
+					     (head.getWeights() - s2.getWeights()).cwiseAbs().maxCoeff());
+		long long local = dl.numLocalParams(), total = 0;
+		MPI_Allreduce(&local, &total, 1, MPI_LONG_LONG, MPI_SUM, PETSC_COMM_WORLD);
+		if(rank == 0){
+			std::cout << size << " ranks: rank 0 stores " << local << " of " << total
+				  << " distributed weights; max difference to one rank after 5 steps " << diff << '\n';
+		}
+		ok = diff < 1.0e-12 and total == (D + 1) * H and local <= ((D + 1 + size - 1) / size) * H;
+	}
+	int allOk = ok;
+	MPI_Allreduce(MPI_IN_PLACE, &allOk, 1, MPI_INT, MPI_LAND, PETSC_COMM_WORLD);
+	if(rank == 0){
+		std::cout << (allOk ? "PASSED\n" : "FAILED\n");
+	}
+	PetscCall(PetscFinalize());
+	return allOk ? 0 : 1;
+}
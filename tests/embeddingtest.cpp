@@ -0,0 +1,70 @@
+#include "../include/EmbeddingLayer.hpp"
+#include "../include/Layer.hpp"
+#include <Eigen/Core>
+#include <iostream>
+#include <random>
+
+using Mat = NN::Mat;
+
+const int vocab = 1000, dim = 4, fields = 3, batch = 16;
+const double lr = 0.05;
+
+//iters steps of emb (feeding a dense layer with one output) next to a dense reference: the
+//same momentum update applied to the full table every step
+void train(NN::EmbeddingLayer& emb, NN::Layer& head, Mat& denseW, Mat& denseV, std::mt19937& gen,
+	   int iters, double momentum){
+	emb.setUpdateParams(lr, momentum);
+	std::uniform_int_distribution<NN::int_t> dist(0, vocab-1);
+
+	for(int it = 0; it < iters; it++){
+		NN::IdMat ids(batch, fields);
+		for(int i = 0; i < ids.size(); i++){
+			ids.data()[i] = dist(gen);
+		}
+
+		emb.forwardPass(ids);
+		head.forwardPass(emb.getOutputs());
+		Mat resid = head.getOutputs() - Mat::Ones(batch, 1);
+		head.backwardPass(resid);
+		emb.backwardPass(head.getInputGrad());
+
+		Mat denseG = Mat::Zero(vocab, dim);
+		const auto& g = emb.getGradient();
+		for(size_t k = 0; k < g.rows.size(); k++){
+			denseG.row(g.rows[k]) = g.values.row(k);
+		}
+		denseV = momentum * denseV - lr * denseG;
+		denseW += denseV;
+
+		emb.updateWeights();
+	}
+}
+
+int main(){
+	bool ok = true;
+
+	//momentum 0.9 throughout; then plain SGD switched to momentum, where the rows the SGD
+	//steps left behind must not carry a velocity into the momentum steps
+	for(double firstMomentum : {0.9, 0.0}){
+		NN::EmbeddingLayer emb(vocab, dim);
+		NN::Layer head(std::make_pair(batch, fields*dim), 1, "linear");
+		head.setUpdateParams(0.0, 0.0);
+		Mat denseW = emb.getWeights();
+		Mat denseV = Mat::Zero(vocab, dim);
+		std::mt19937 gen(42);
+
+		train(emb, head, denseW, denseV, gen, 25, firstMomentum);
+		if(firstMomentum == 0.0){
+			train(emb, head, denseW, denseV, gen, 25, 0.9);
+		}
+
+		double err = (emb.getWeights() - denseW).cwiseAbs().maxCoeff();
+		std::cout << "Touched rows in last batch: " << emb.getGradient().rows.size() << " of " << vocab << '\n';
+		std::cout << "Max difference between lazy sparse and dense momentum weights"
+			  << (firstMomentum == 0.0 ? " (after switching from momentum 0): " : ": ") << err << '\n';
+		ok = ok and err < 1.0e-12;
+	}
+
+	std::cout << (ok ? "PASSED\n" : "FAILED\n");
+	return ok ? 0 : 1;
+}
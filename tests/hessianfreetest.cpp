@@ -0,0 +1,73 @@
+#include "../include/HessianFree.hpp"
+#include "../include/Network.hpp"
+#include "../include/Layer.hpp"
+#include <Eigen/Core>
+#include <iostream>
+#include <cmath>
+
+using Mat = NN::Mat;
+using Vec = NN::Vec;
+
+int main(){
+	bool ok = true;
+
+	//a sin fit on 40 points, tanh 1 -> 10 -> 10 -> 1 with a linear output
+	const int N = 40;
+	Mat xs(N, 1);
+	Vec ys(N);
+	for(int i = 0; i < N; i++){
+		xs(i, 0) = -3.0 + 6.0 * i / (N - 1);
+		ys[i] = std::sin(xs(i, 0));
+	}
+	NN::Layer l1(std::make_pair(N, 1), 10, "tanh");
+	NN::Layer l2(std::make_pair(N, 10), 10, "tanh");
+	NN::Layer l3(std::make_pair(N, 10), 1, "linear");
+	NN::Network net("tanh", "L2", {l1, l2, l3});
+	net.getLayersRef().back().setActivation("linear");
+	net.setInputs(xs);
+	net.setTarget(ys, true);
+	net.predict();
+
+	//the R-operator Hessian product against central differences of the gradient
+	Vec x = net.getFlatWeights();
+	Vec v = Vec::Random(x.size());
+	Vec Hv = net.hessianVectorProduct(v);
+	const double h = 1.0e-5;
+	Vec gp(x.size()), gm(x.size());
+	net.lossAndGradient(x + h * v, gp);
+	net.lossAndGradient(x - h * v, gm);
+	Vec fdHv = (gp - gm) / (2*h);
+	net.setFlatWeights(x);
+	net.predict();
+	const double hErr = (Hv - fdHv).norm() / fdHv.norm();
+	std::cout << net.numParams() << " parameters, Hessian-vector product relative error vs. finite differences: "
+		  << hErr << '\n';
+	ok = ok and hErr < 1.0e-6;
+
+	//the Gauss-Newton product against J^T J v from the explicit Jacobian
+	Vec Gv = net.hessianVectorProduct(v, true);
+	Mat J = net.outputJacobian();
+	Vec JtJv = J.transpose() * (J * v);
+	const double gErr = (Gv - JtJv).norm() / JtJv.norm();
+	std::cout << "Gauss-Newton product relative error vs. J^T J v: " << gErr << '\n';
+	ok = ok and gErr < 1.0e-10;
+
+	for(bool gaussNewton : {true, false}){
+		net.setFlatWeights(x);
+		NN::NewtonCGOptions opts;
+		opts.gaussNewton = gaussNewton;
+		opts.gradTol = 1.0e-6;
+		opts.maxIter = 500;
+		NN::NewtonCGTrainer hf(opts);
+		bool converged = hf.train(net, std::nullopt, std::nullopt, true);
+		const double rms = std::sqrt(2.0 * net.getScalarLoss() / N);
+		std::cout << (gaussNewton ? "Gauss-Newton" : "exact Hessian") << " Newton-CG "
+			  << (converged ? "converged" : "did not converge") << " in "
+			  << hf.getLossHistory().size() - 1 << " steps, "
+			  << hf.getNumHessianProducts() << " curvature products; RMS error " << rms << '\n';
+		ok = ok and rms < 1.0e-3;
+	}
+
+	std::cout << (ok ? "PASSED\n" : "FAILED\n");
+	return ok ? 0 : 1;
+}
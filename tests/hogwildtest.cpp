@@ -0,0 +1,75 @@
+#include "../include/Hogwild.hpp"
+#include "../include/Network.hpp"
+#include "../include/Layer.hpp"
+#include <Eigen/Core>
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <cmath>
+
+using Mat = NN::Mat;
+using Vec = NN::Vec;
+
+int main(){
+	bool ok = true;
+
+	//sparse features: 4 of 200 columns set per row
+	const int N = 4000, D = 200;
+	std::mt19937 gen(7);
+	std::uniform_int_distribution<int> col(0, D - 1);
+	std::uniform_real_distribution<double> val(-1.0, 1.0);
+	Mat X = Mat::Zero(N, D);
+	for(int i = 0; i < N; i++){
+		for(int k = 0; k < 4; k++){
+			X(i, col(gen)) = val(gen);
+		}
+	}
+	Vec wTrue = Vec::Random(D);
+	Vec y = (X * wTrue).array().tanh();
+
+	NN::Layer l1(std::make_pair(N, D), 8, "tanh");
+	NN::Layer l2(std::make_pair(N, 8), 1, "linear");
+	NN::Network base("tanh", "L2", {l1, l2});
+	base.getLayersRef().back().setActivation("linear");
+	base.setInputs(X);
+	base.setTarget(y, true);
+	base.predict();
+	const double initialLoss = base.getScalarLoss() / N;
+	const int_fast64_t P = base.numParams();
+
+	for(int threads : {1, 4}){
+		NN::Network net = base;
+		NN::HogwildOptions opts;
+		opts.numThreads = threads;
+		opts.batchSize = 8;
+		opts.epochs = 30;
+		opts.learningRate = 0.05;
+		NN::HogwildTrainer hw(opts);
+		auto t0 = std::chrono::steady_clock::now();
+		hw.train(net, X, y, true);
+		double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+		const double finalLoss = net.getScalarLoss() / N;
+		const int_fast64_t updates = opts.epochs * ((N + opts.batchSize - 1) / opts.batchSize);
+		const double written = static_cast<double>(hw.getNumWrites()) / (updates * P);
+		std::cout << threads << " thread(s): mean loss " << initialLoss << " -> " << finalLoss
+			  << " in " << secs << " s; fraction of weights written per update " << written << '\n';
+		ok = ok and finalLoss < 0.05 * initialLoss and written < 0.5;
+	}
+
+	//a worker's exception reaches the caller instead of terminating the process
+	{
+		NN::Network net = base;
+		NN::HogwildTrainer hw;
+		bool threw = false;
+		try{
+			hw.train(net, X.leftCols(D - 1), y, true);
+		} catch(const char*){
+			threw = true;
+		}
+		std::cout << "worker exception rethrown: " << threw << '\n';
+		ok = ok and threw;
+	}
+
+	std::cout << (ok ? "PASSED\n" : "FAILED\n");
+	return ok ? 0 : 1;
+}
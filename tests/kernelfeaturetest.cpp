@@ -0,0 +1,126 @@
+#include "../include/KernelFeatureLayer.hpp"
+#include "../include/Layer.hpp"
+#include <Eigen/Core>
+#include <iostream>
+#include <cmath>
+
+using Mat = NN::Mat;
+
+//fits y = sin(3x) on [-1,1] with fixed features followed by a linear Layer
+template<typename FeatureLayer>
+double fitSine(FeatureLayer& features, int iters)
+{
+	const int n = 64;
+	Mat X(n, 1), Y(n, 1);
+	for(int i = 0; i < n; i++){
+		X(i,0) = -1.0 + 2.0 * i / (n - 1);
+		Y(i,0) = std::sin(3.0 * X(i,0));
+	}
+	NN::Layer head(std::make_pair(n, features.getOutputSize()), 1, "linear");
+	head.setUpdateParams(0.5 / n, 0.9);
+
+	double loss = 0.0;
+	for(int it = 0; it < iters; it++){
+		features.forwardPass(X);
+		head.forwardPass(features.getOutputs());
+		Mat resid = head.getOutputs() - Y;
+		loss = 0.5 * resid.squaredNorm() / n;
+		head.backwardPass(resid);
+		features.backwardPass(head.getInputGrad());
+		head.updateWeights();
+		features.updateWeights();
+	}
+	return loss;
+}
+
+int main(){
+	bool ok = true;
+
+	NN::RBFLayer rbf(1, 20, 0.2);
+	Mat c(20, 1);
+	for(int j = 0; j < 20; j++){
+		c(j,0) = -1.0 + 2.0 * j / 19;
+	}
+	rbf.setCentres(c);
+	double rbfLoss = fitSine(rbf, 3000);
+	std::cout << "RBF + Layer final loss: " << rbfLoss << '\n';
+	ok = ok and rbfLoss < 1.0e-3;
+
+	NN::RandomFourierLayer rff(1, 100, 0.5, false, 7);
+	double rffLoss = fitSine(rff, 3000);
+	std::cout << "RFF + Layer final loss: " << rffLoss << '\n';
+	ok = ok and rffLoss < 1.0e-3;
+
+	//finite-difference checks of the trainable parameter and input gradients
+	const double h = 1.0e-6;
+	Mat X = Mat::Random(7, 3);
+	Mat W = Mat::Random(5, 1);
+	NN::RBFLayer trbf(3, 5, 0.8, true);
+	NN::RandomFourierLayer trff(3, 5, 1.0, true, 3);
+	auto rbfLoss2 = [&](NN::RBFLayer& l, const Mat& x) {
+		l.forwardPass(x);
+		return 0.5 * (l.getOutputs() * W).squaredNorm();
+	};
+	auto rffLoss2 = [&](NN::RandomFourierLayer& l, const Mat& x) {
+		l.forwardPass(x);
+		return 0.5 * (l.getOutputs() * W).squaredNorm();
+	};
+
+	trbf.forwardPass(X);
+	trbf.backwardPass((trbf.getOutputs() * W) * W.transpose());
+	auto [gc, gw] = trbf.getGradient();
+	Mat gx = trbf.getInputGrad();
+	trff.forwardPass(X);
+	trff.backwardPass((trff.getOutputs() * W) * W.transpose());
+	auto [gf, gp] = trff.getGradient();
+	Mat gxf = trff.getInputGrad();
+
+	double err = 0.0;
+	for(int k = 0; k < 5; k++){
+		Mat cp = trbf.getCentres(), cm = cp;
+		cp(k, k % 3) += h;
+		cm(k, k % 3) -= h;
+		NN::RBFLayer a = trbf, b = trbf;
+		a.setCentres(cp);
+		b.setCentres(cm);
+		err = std::max(err, std::abs((rbfLoss2(a, X) - rbfLoss2(b, X)) / (2*h) - gc(k, k % 3)));
+
+		Mat wp = trbf.getWidths(), wm = wp;
+		wp(0,k) += h;
+		wm(0,k) -= h;
+		a = trbf;
+		b = trbf;
+		a.setWidths(wp);
+		b.setWidths(wm);
+		err = std::max(err, std::abs((rbfLoss2(a, X) - rbfLoss2(b, X)) / (2*h) - gw(0,k)));
+
+		Mat xp = X, xm = X;
+		xp(k, k % 3) += h;
+		xm(k, k % 3) -= h;
+		a = trbf;
+		err = std::max(err, std::abs((rbfLoss2(a, xp) - rbfLoss2(a, xm)) / (2*h) - gx(k, k % 3)));
+
+		NN::RandomFourierLayer fa = trff, fb = trff;
+		Mat fp = trff.getFreqs(), fm = fp;
+		fp(k % 3, k) += h;
+		fm(k % 3, k) -= h;
+		fa.setFreqs(fp, trff.getPhases());
+		fb.setFreqs(fm, trff.getPhases());
+		err = std::max(err, std::abs((rffLoss2(fa, X) - rffLoss2(fb, X)) / (2*h) - gf(k % 3, k)));
+
+		Mat pp = trff.getPhases(), pm = pp;
+		pp(0,k) += h;
+		pm(0,k) -= h;
+		fa.setFreqs(trff.getFreqs(), pp);
+		fb.setFreqs(trff.getFreqs(), pm);
+		err = std::max(err, std::abs((rffLoss2(fa, X) - rffLoss2(fb, X)) / (2*h) - gp(0,k)));
+
+		fa = trff;
+		err = std::max(err, std::abs((rffLoss2(fa, xp) - rffLoss2(fa, xm)) / (2*h) - gxf(k, k % 3)));
+	}
+	std::cout << "Max gradient error vs. finite differences: " << err << '\n';
+	ok = ok and err < 1.0e-6;
+
+	std::cout << (ok ? "PASSED\n" : "FAILED\n");
+	return ok ? 0 : 1;
+}
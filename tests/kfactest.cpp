@@ -0,0 +1,106 @@
+#include "../include/KFAC.hpp"
+#include "../include/Network.hpp"
+#include "../include/Layer.hpp"
+#include <Eigen/Core>
+#include <iostream>
+#include <cmath>
+
+using Mat = NN::Mat;
+using Vec = NN::Vec;
+
+int main(){
+	bool ok = true;
+
+	//badly scaled features: condition number of X^T X around 1e6
+	const int N = 64;
+	Mat X = Mat::Random(N, 4);
+	X.col(0) *= 10.0;
+	X.col(2) *= 0.1;
+	X.col(3) *= 0.01;
+	Vec y(N);
+	for(int i = 0; i < N; i++){
+		y[i] = 0.3 * std::tanh(0.1 * X(i, 0) + X(i, 1)) + 2.0 * X(i, 2) - 0.5;
+	}
+
+	//one linear layer: the Gauss-Newton Kronecker factors are exact, so one unit step solves it
+	{
+		NN::Layer lin(std::make_pair(N, 4), 1, "linear");
+		NN::Network net("linear", "L2", {lin});
+		net.setInputs(X);
+		net.setTarget(y, true);
+		NN::OptimizerParams sgd;
+		sgd.learningRate = 1.0;
+		net.setOptimizer(NN::UpdateRule::Momentum, sgd);
+		NN::KFACOptions opts;
+		opts.decay = 0.0;
+		opts.damping = 1.0e-14;
+		opts.klClip = 0.0;
+		opts.inversionPeriod = 1;
+		opts.async = false;
+		NN::KFACOptimizer kfac(opts);
+		net.predict();
+		const double before = net.getScalarLoss();
+		kfac.step(net);
+		net.predict();
+		Mat Xb = NN::Layer::makeInputMat(X);
+		Vec lsResid = Xb * Xb.colPivHouseholderQr().solve(y) - y;
+		const double lsLoss = 0.5 * lsResid.squaredNorm();
+		std::cout << "linear layer: loss " << before << " -> " << net.getScalarLoss()
+			  << " after one K-FAC step; least-squares optimum " << lsLoss << '\n';
+		ok = ok and std::abs(net.getScalarLoss() - lsLoss) < 1.0e-8 * before;
+	}
+
+	//4 -> 8 tanh -> 1 linear: iterations to a loss tolerance, momentum alone vs. K-FAC
+	NN::Layer l1(std::make_pair(N, 4), 8, "tanh");
+	NN::Layer l2(std::make_pair(N, 8), 1, "linear");
+	NN::Network base("tanh", "L2", {l1, l2});
+	base.getLayersRef().back().setActivation("linear");
+	base.setInputs(X);
+	base.setTarget(y, true);
+	const Vec w0 = base.getFlatWeights();
+	const double lossTol = 1.0e-3;
+	const size_t maxIter = 20000;
+
+	auto iterationsToTol = [&](NN::Network& net, auto&& step) -> size_t {
+		net.setFlatWeights(w0);
+		net.predict();
+		size_t it = 0;
+		while(it < maxIter and net.getScalarLoss() > lossTol){
+			step(net);
+			net.predict();
+			it++;
+		}
+		return it;
+	};
+
+	NN::Network gd = base;
+	NN::OptimizerParams mom;
+	mom.learningRate = 5.0e-4;
+	mom.momentum = 0.9;
+	gd.setOptimizer(NN::UpdateRule::Momentum, mom);
+	size_t gdIters = iterationsToTol(gd, [](NN::Network& net){
+		net.backwardPass();
+		net.updateWeights();
+	});
+	std::cout << "momentum: " << gdIters << " iterations to loss " << lossTol
+		  << " (loss " << gd.getScalarLoss() << ")\n";
+
+	for(bool async : {false, true}){
+		NN::Network net = base;
+		NN::OptimizerParams kp;
+		kp.learningRate = 0.5;
+		kp.momentum = 0.9;
+		net.setOptimizer(NN::UpdateRule::Momentum, kp);
+		NN::KFACOptions opts;
+		opts.async = async;
+		NN::KFACOptimizer kfac(opts);
+		size_t kIters = iterationsToTol(net, [&](NN::Network& n){ kfac.step(n); });
+		std::cout << (async ? "K-FAC, background inversion: " : "K-FAC, inline inversion: ")
+			  << kIters << " iterations, " << kfac.getNumInversions() << " inversions (loss "
+			  << net.getScalarLoss() << ")\n";
+		ok = ok and net.getScalarLoss() <= lossTol and 5 * kIters < gdIters;
+	}
+
+	std::cout << (ok ? "PASSED\n" : "FAILED\n");
+	return ok ? 0 : 1;
+}
@@ -55,8 +55,14 @@ int main(){
 
 	std::cout << "New prediction:\n" << outputs << '\n';
 
-
-	
-	return 0;
+	//forward passes on new data keep the trained weights
+	auto trained = testLayer.getWeights();
+	testLayer.forwardPass(input);
+	testLayer.forwardPass(0.5 * input);
+	bool ok = testLayer.getWeights() == trained;
+	std::cout << "Weights unchanged by two forward passes: " << ok << '\n';
+
+	std::cout << (ok ? "PASSED\n" : "FAILED\n");
+	return ok ? 0 : 1;
 }
 
@@ -0,0 +1,58 @@
+#include "../include/LBFGS.hpp"
+#include "../include/Network.hpp"
+#include "../include/Layer.hpp"
+#include <Eigen/Core>
+#include <iostream>
+#include <cmath>
+
+using Mat = NN::Mat;
+using Vec = NN::Vec;
+
+int main(){
+	bool ok = true;
+
+	//the networktest problem: 2 samples of 10 features, sigmoid layers 10 -> 8 -> 5 -> 1
+	NN::Layer l1(std::make_pair(2, 10), 8, "sigmoid");
+	NN::Layer l2(std::make_pair(2, 8), 5, "sigmoid");
+	NN::Layer l3(std::make_pair(2, 5), 1, "sigmoid");
+	NN::Network net("sigmoid", "L2", {l1, l2, l3});
+
+	Mat input = Mat::Random(2, 10);
+	Vec targ = 0.15 * Vec::Ones(2);
+	net.setInputs(input);
+	net.setTarget(targ, true);
+
+	//the flat gradient against finite differences
+	Vec x = net.getFlatWeights();
+	Vec g(x.size());
+	net.lossAndGradient(x, g);
+	double gErr = 0.0;
+	const double h = 1.0e-6;
+	Vec gtmp(x.size());
+	for(int i = 0; i < x.size(); i += 7){
+		Vec xp = x, xm = x;
+		xp[i] += h;
+		xm[i] -= h;
+		double fd = (net.lossAndGradient(xp, gtmp) - net.lossAndGradient(xm, gtmp)) / (2*h);
+		gErr = std::max(gErr, std::abs(fd - g[i]));
+	}
+	net.setFlatWeights(x);
+	std::cout << net.numParams() << " parameters, flat gradient max error vs. finite differences: " << gErr << '\n';
+	ok = ok and gErr < 1.0e-7;
+
+	NN::LBFGSOptions opts;
+	opts.historySize = 8;
+	opts.gradTol = 1.0e-5;
+	NN::LBFGSTrainer lbfgs(opts);
+	bool converged = lbfgs.train(net);
+
+	std::cout << "Target :\n" << targ << "\n Trained Prediction: \n" << net.getOutputs() << '\n';
+	std::cout << "L-BFGS " << (converged ? "converged" : "did not converge") << " in "
+		  << lbfgs.getLossHistory().size() - 1 << " iterations, "
+		  << lbfgs.getNumEvaluations() << " function evaluations; final loss "
+		  << lbfgs.getLossHistory().back() << '\n';
+	ok = ok and converged;
+
+	std::cout << (ok ? "PASSED\n" : "FAILED\n");
+	return ok ? 0 : 1;
+}
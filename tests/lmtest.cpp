@@ -0,0 +1,98 @@
+#include "../include/LevenbergMarquardt.hpp"
+#include "../include/Network.hpp"
+#include "../include/Layer.hpp"
+#include <Eigen/Core>
+#include <iostream>
+#include <cmath>
+
+using Mat = NN::Mat;
+using Vec = NN::Vec;
+
+int main(){
+	bool ok = true;
+
+	//the networktest problem: 2 samples of 10 features, sigmoid layers 10 -> 8 -> 5 -> 1
+	NN::Layer l1(std::make_pair(2, 10), 8, "sigmoid");
+	NN::Layer l2(std::make_pair(2, 8), 5, "sigmoid");
+	NN::Layer l3(std::make_pair(2, 5), 1, "sigmoid");
+	NN::Network net("sigmoid", "L2", {l1, l2, l3});
+
+	Mat input = Mat::Random(2, 10);
+	Vec targ = 0.15 * Vec::Ones(2);
+	net.setInputs(input);
+	net.setTarget(targ, true);
+	net.predict();
+
+	//the output Jacobian against finite differences of the outputs
+	Vec x = net.getFlatWeights();
+	Mat J = net.outputJacobian();
+	double jErr = 0.0;
+	const double h = 1.0e-6;
+	for(int i = 0; i < x.size(); i += 5){
+		Vec xp = x, xm = x;
+		xp[i] += h;
+		xm[i] -= h;
+		net.setFlatWeights(xp);
+		Vec op = net.predictVal();
+		net.setFlatWeights(xm);
+		Vec om = net.predictVal();
+		jErr = std::max(jErr, ((op - om) / (2*h) - J.col(i)).cwiseAbs().maxCoeff());
+	}
+	net.setFlatWeights(x);
+	net.predict();
+	std::cout << J.rows() << " x " << J.cols() << " output Jacobian max error vs. finite differences: " << jErr << '\n';
+	ok = ok and jErr < 1.0e-7;
+
+	NN::LMOptions opts;
+	opts.lossTol = 1.0e-14;
+	NN::LevenbergMarquardtTrainer lm(opts);
+	bool converged = lm.train(net);
+	std::cout << "Target :\n" << targ << "\n Trained Prediction: \n" << net.getOutputs() << '\n';
+	std::cout << "LM " << (converged ? "converged" : "did not converge") << " in "
+		  << lm.getLossHistory().size() - 1 << " accepted steps; final loss "
+		  << lm.getLossHistory().back() << '\n';
+	ok = ok and converged;
+
+	//a least-squares fit of sin on 40 points, tanh 1 -> 12 -> 1 with a linear output
+	const int N = 40;
+	Mat xs(N, 1);
+	Vec ys(N);
+	for(int i = 0; i < N; i++){
+		xs(i, 0) = -3.0 + 6.0 * i / (N - 1);
+		ys[i] = std::sin(xs(i, 0));
+	}
+	NN::Layer s1(std::make_pair(N, 1), 12, "tanh");
+	NN::Layer s2(std::make_pair(N, 12), 1, "linear");
+	NN::Network fit("tanh", "L2", {s1, s2});
+	fit.getLayersRef().back().setActivation("linear");
+	fit.setInputs(xs);
+	fit.setTarget(ys, true);
+
+	NN::LMOptions fitOpts;
+	fitOpts.gradTol = 1.0e-10;
+	fitOpts.maxIter = 500;
+	NN::LevenbergMarquardtTrainer fitLM(fitOpts);
+	fitLM.train(fit, std::nullopt, std::nullopt, true);
+	const double rms = std::sqrt(2.0 * fit.getScalarLoss() / N);
+	std::cout << "sin fit: " << fit.numParams() << " parameters, "
+		  << fitLM.getLossHistory().size() - 1 << " accepted steps, RMS error " << rms << '\n';
+	ok = ok and rms < 1.0e-3;
+
+	//the CG path on the same fit must agree with the direct solve
+	NN::Layer c1(std::make_pair(N, 1), 12, "tanh");
+	NN::Layer c2(std::make_pair(N, 12), 1, "linear");
+	NN::Network fitCG("tanh", "L2", {c1, c2});
+	fitCG.getLayersRef().back().setActivation("linear");
+	fitCG.setInputs(xs);
+	fitCG.setTarget(ys, true);
+	fitOpts.directMaxParams = 0;
+	NN::LevenbergMarquardtTrainer cgLM(fitOpts);
+	cgLM.train(fitCG, std::nullopt, std::nullopt, true);
+	const double rmsCG = std::sqrt(2.0 * fitCG.getScalarLoss() / N);
+	std::cout << "sin fit with CG solves: " << cgLM.getLossHistory().size() - 1
+		  << " accepted steps, RMS error " << rmsCG << '\n';
+	ok = ok and rmsCG < 1.0e-3;
+
+	std::cout << (ok ? "PASSED\n" : "FAILED\n");
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,88 @@
+#include "../include/MiniBatch.hpp"
+#include "../include/Network.hpp"
+#include "../include/Layer.hpp"
+#include <Eigen/Core>
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+
+using Mat = NN::Mat;
+using Vec = NN::Vec;
+
+int main(){
+	bool ok = true;
+
+	const int N = 2003;
+	Mat X = Mat::Random(N, 2);
+	Vec y(N);
+	for(int i = 0; i < N; i++){
+		y[i] = std::sin(2.0 * X(i, 0)) + 0.5 * X(i, 1);
+	}
+	NN::Layer l1(std::make_pair(N, 2), 16, "tanh");
+	NN::Layer l2(std::make_pair(N, 16), 1, "linear");
+	NN::Network base("tanh", "L2", {l1, l2});
+	base.getLayersRef().back().setActivation("linear");
+	base.setInputs(X);
+	base.setTarget(y, true);
+	NN::OptimizerParams sgd;
+	sgd.learningRate = 2.0e-3;
+	sgd.momentum = 0.9;
+	base.setOptimizer(NN::UpdateRule::Momentum, sgd);
+	base.predict();
+	const double initialLoss = base.getScalarLoss() / N;
+
+	//batches per epoch under each final-batch policy, and a fresh permutation every epoch
+	const size_t epochs = 10;
+	for(auto policy : {NN::FinalBatch::Partial, NN::FinalBatch::DropLast, NN::FinalBatch::Pad}){
+		NN::Network net = base;
+		NN::MiniBatchOptions opts;
+		opts.batchSize = 32;
+		opts.epochs = 1;
+		opts.finalBatch = policy;
+		NN::MiniBatchTrainer mb(opts);
+		mb.train(net, X, y, true);
+		auto first = mb.getPermutation();
+		mb.train(net, X, y, true);
+		auto second = mb.getPermutation();
+		auto sorted = second;
+		std::sort(sorted.begin(), sorted.end());
+		bool isPerm = true;
+		for(int i = 0; i < N; i++){
+			isPerm = isPerm and sorted[i] == i;
+		}
+		const size_t expected = policy == NN::FinalBatch::DropLast ? N / 32 : (N + 31) / 32;
+		std::cout << "policy " << static_cast<int>(policy) << ": " << mb.getBatchLoss().size() / 2
+			  << " batches per epoch (expected " << expected << "), reshuffled "
+			  << (first != second) << ", permutation " << isPerm << '\n';
+		ok = ok and mb.getBatchLoss().size() == 2 * expected and first != second and isPerm;
+	}
+
+	//per pass over the data, mini-batches against full-batch gradient descent
+	NN::Network net = base;
+	NN::MiniBatchOptions opts;
+	opts.batchSize = 32;
+	opts.epochs = epochs;
+	NN::MiniBatchTrainer mb(opts);
+	mb.train(net, X, y);
+	net.setBatch(X, y);
+	net.predict();
+	const double mbLoss = net.getScalarLoss() / N;
+
+	NN::Network full = base;
+	NN::OptimizerParams fullParams = sgd;
+	fullParams.learningRate = 2.0e-4;
+	full.setOptimizer(NN::UpdateRule::Momentum, fullParams);
+	for(size_t e = 0; e < epochs; e++){
+		full.predict();
+		full.backwardPass();
+		full.updateWeights();
+	}
+	full.predict();
+	const double fullLoss = full.getScalarLoss() / N;
+	std::cout << "mean loss after " << epochs << " passes over " << N << " rows: initial " << initialLoss
+		  << ", mini-batch " << mbLoss << ", full batch " << fullLoss << '\n';
+	ok = ok and mbLoss < 0.01 * initialLoss and mbLoss < 0.1 * fullLoss;
+
+	std::cout << (ok ? "PASSED\n" : "FAILED\n");
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,231 @@
+#include "../include/MPITrainer.hpp"
+#include "../include/Network.hpp"
+#include "../include/Layer.hpp"
+#include <Eigen/Core>
+#include <mpi.h>
+#include <iostream>
+#include <cmath>
+
+using Mat = NN::Mat;
+using Vec = NN::Vec;
+
+//run with e.g. mpirun -np 4 ./mpitest
+int main(int argc, char** argv){
+	MPI_Init(&argc, &argv);
+	int rank, size;
+	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+	MPI_Comm_size(MPI_COMM_WORLD, &size);
+	bool ok = true;
+
+	//every rank builds the same data set and keeps rows rank, rank + size, ...
+	const int N = 800;
+	std::srand(3);
+	Mat X = Mat::Random(N, 6);
+	Vec y = X.rowwise().sum().array().sin();
+	const int n = (N - rank + size - 1) / size;
+	Mat Xlocal(n, 6);
+	Vec ylocal(n);
+	for(int i = 0; i < n; i++){
+		Xlocal.row(i) = X.row(rank + i * size);
+		ylocal[i] = y[rank + i * size];
+	}
+
+	NN::Layer l1(std::make_pair(N, 6), 32, "tanh");
+	NN::Layer l2(std::make_pair(N, 32), 16, "tanh");
+	NN::Layer l3(std::make_pair(N, 16), 1, "linear");
+	NN::Network base("tanh", "L2", {l1, l2, l3});
+	base.getLayersRef().back().setActivation("linear");
+	base.setInputs(X);
+	base.setTarget(y, true);
+	NN::OptimizerParams sgd;
+	sgd.learningRate = 1.0e-3;
+	sgd.momentum = 0.9;
+	base.setOptimizer(NN::UpdateRule::Momentum, sgd);
+
+	//buckets small enough for one layer each
+	NN::MPITrainerOptions opts;
+	opts.bucketBytes = 128;
+	opts.batchSize = 50;
+	opts.epochs = 40;
+	NN::MPIDataParallelTrainer mpi(MPI_COMM_WORLD, opts);
+
+	//one step on the shards against a serial full-batch step
+	NN::Network serial = base, parallel = base;
+	mpi.broadcastWeights(serial);
+	mpi.broadcastWeights(parallel);
+	serial.setBatch(X, y);
+	serial.predict();
+	serial.backwardPass();
+	serial.updateWeights();
+	const double loss = mpi.step(parallel, Xlocal, ylocal);
+	double wDiff = (serial.getFlatWeights() - parallel.getFlatWeights()).cwiseAbs().maxCoeff();
+	MPI_Allreduce(MPI_IN_PLACE, &wDiff, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+	if(rank == 0){
+		std::cout << size << " ranks, " << mpi.getNumBuckets() << " buckets: loss " << loss
+			  << " vs. serial " << serial.getScalarLoss()
+			  << ", max weight difference after one step " << wDiff << '\n';
+	}
+	ok = ok and std::abs(loss - serial.getScalarLoss()) < 1.0e-10 * loss and wDiff < 1.0e-12
+		and mpi.getNumBuckets() == 3;
+
+	//training on the shards: the loss drops and the ranks stay in lockstep
+	NN::Network net = base;
+	mpi.train(net, Xlocal, ylocal, true);
+	const auto epochLoss = mpi.getEpochLoss();
+	Vec w = net.getFlatWeights(), w0 = w;
+	MPI_Bcast(w0.data(), w0.size(), MPI_DOUBLE, 0, MPI_COMM_WORLD);
+	int same = w == w0;
+	MPI_Allreduce(MPI_IN_PLACE, &same, 1, MPI_INT, MPI_LAND, MPI_COMM_WORLD);
+	if(rank == 0){
+		std::cout << "training: epoch loss " << epochLoss.front() << " -> " << epochLoss.back()
+			  << ", weights identical on all ranks " << same
+			  << ", time waiting on reductions " << mpi.getWaitSeconds() << " s\n";
+	}
+	ok = ok and same and epochLoss.back() < 0.05 * epochLoss.front();
+
+	//the same with compression of plain SGD steps; PowerSGD gains less on layers this narrow
+	for(auto [method, name, minRatio] : {std::make_tuple(NN::Compression::TopK, "top-1%", 50.0),
+					     std::make_tuple(NN::Compression::Sign, "1-bit", 50.0),
+					     std::make_tuple(NN::Compression::PowerSGD, "PowerSGD rank 2", 3.0)}){
+		NN::MPITrainerOptions copts = opts;
+		copts.compression.method = method;
+		NN::MPIDataParallelTrainer cmpi(MPI_COMM_WORLD, copts);
+		NN::Network cnet = base;
+		sgd.momentum = 0.0;
+		sgd.learningRate = 1.0e-3;
+		cnet.setOptimizer(NN::UpdateRule::Momentum, sgd);
+		cmpi.train(cnet, Xlocal, ylocal, true);
+		const auto closs = cmpi.getEpochLoss();
+		Vec cw = cnet.getFlatWeights(), cw0 = cw;
+		MPI_Bcast(cw0.data(), cw0.size(), MPI_DOUBLE, 0, MPI_COMM_WORLD);
+		int csame = cw == cw0;
+		MPI_Allreduce(MPI_IN_PLACE, &csame, 1, MPI_INT, MPI_LAND, MPI_COMM_WORLD);
+		if(rank == 0){
+			std::cout << name << ": "
+				  << cmpi.compressionRatio() << "x fewer bytes, epoch loss " << closs.front()
+				  << " -> " << closs.back() << " (uncompressed " << epochLoss.back()
+				  << "), weights identical on all ranks " << csame << '\n';
+		}
+		ok = ok and csame and cmpi.compressionRatio() > minRatio and closs.back() < 0.05 * closs.front();
+	}
+
+	//the same trainer on a network of the same depth but other widths lays out new buckets
+	{
+		NN::Layer w1(std::make_pair(N, 6), 8, "tanh");
+		NN::Layer w2(std::make_pair(N, 8), 64, "tanh");
+		NN::Layer w3(std::make_pair(N, 64), 1, "linear");
+		NN::Network wide("tanh", "L2", {w1, w2, w3});
+		wide.getLayersRef().back().setActivation("linear");
+		wide.setInputs(X);
+		wide.setTarget(y, true);
+		wide.setOptimizer(NN::UpdateRule::Momentum, sgd);
+		NN::Network wideSerial = wide, wideParallel = wide;
+		mpi.broadcastWeights(wideSerial);
+		mpi.broadcastWeights(wideParallel);
+		wideSerial.setBatch(X, y);
+		wideSerial.predict();
+		wideSerial.backwardPass();
+		wideSerial.updateWeights();
+		mpi.step(wideParallel, Xlocal, ylocal);
+		double wideDiff = (wideSerial.getFlatWeights() - wideParallel.getFlatWeights()).cwiseAbs().maxCoeff();
+		MPI_Allreduce(MPI_IN_PLACE, &wideDiff, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+		if(rank == 0){
+			std::cout << "reshaped network on the same trainer: max weight difference " << wideDiff << '\n';
+		}
+		ok = ok and wideDiff < 1.0e-12;
+	}
+
+	//rank 0 without data: every rank throws instead of the others waiting on it
+	{
+		int threw = 0;
+		NN::Network empty = base;
+		try{
+			mpi.train(empty, rank == 0 ? Xlocal.topRows(0) : Xlocal, rank == 0 ? ylocal.head(0) : ylocal, true);
+		} catch(const char*){
+			threw = 1;
+		}
+		MPI_Allreduce(MPI_IN_PLACE, &threw, 1, MPI_INT, MPI_LAND, MPI_COMM_WORLD);
+		ok = ok and threw;
+	}
+
+	//ZeRO-1/2 with Adam: the same weights as unsharded Adam, a 1/size share of the state;
+	//L2 on the shards' non-bias weights and clipping by the norm summed over the shards
+	NN::OptimizerParams adam;
+	adam.learningRate = 1.0e-3;
+	adam.l2 = 1.0e-2;
+	base.setOptimizer(NN::UpdateRule::Adam, adam);
+	base.setGradientClipping(1.0);
+	opts.epochs = 5;
+	NN::Network unsharded = base;
+	NN::MPIDataParallelTrainer(MPI_COMM_WORLD, opts).train(unsharded, Xlocal, ylocal, true);
+	for(int stage : {1, 2}){
+		NN::MPITrainerOptions zopts = opts;
+		zopts.zeroStage = stage;
+		NN::MPIDataParallelTrainer zmpi(MPI_COMM_WORLD, zopts);
+		NN::Network znet = base;
+		zmpi.train(znet, Xlocal, ylocal, true);
+		double zDiff = (znet.getFlatWeights() - unsharded.getFlatWeights()).cwiseAbs().maxCoeff();
+		MPI_Allreduce(MPI_IN_PLACE, &zDiff, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+		const double share = static_cast<double>(zmpi.shardStateSize()) / (2 * base.numParams());
+		if(rank == 0){
+			std::cout << "ZeRO-" << stage << ": max weight difference to unsharded Adam " << zDiff
+				  << ", optimizer state on rank 0 " << share << " of unsharded\n";
+		}
+		ok = ok and zDiff < 1.0e-10 and std::abs(share - 1.0 / size) < 0.01;
+	}
+
+	//switching from Adam to momentum partway through starts the shards from fresh state, as
+	//setOptimizer does for the unsharded layers
+	{
+		NN::MPITrainerOptions zopts = opts;
+		zopts.zeroStage = 1;
+		NN::MPIDataParallelTrainer plain(MPI_COMM_WORLD, opts), zmpi(MPI_COMM_WORLD, zopts);
+		NN::Network unshardedNet = base, shardedNet = base;
+		plain.train(unshardedNet, Xlocal, ylocal, true);
+		zmpi.train(shardedNet, Xlocal, ylocal, true);
+		sgd.momentum = 0.9;
+		unshardedNet.setOptimizer(NN::UpdateRule::Momentum, sgd);
+		shardedNet.setOptimizer(NN::UpdateRule::Momentum, sgd);
+		plain.train(unshardedNet, Xlocal, ylocal, true);
+		zmpi.train(shardedNet, Xlocal, ylocal, true);
+		double switchDiff = (shardedNet.getFlatWeights() - unshardedNet.getFlatWeights()).cwiseAbs().maxCoeff();
+		MPI_Allreduce(MPI_IN_PLACE, &switchDiff, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+		if(rank == 0){
+			std::cout << "ZeRO-1, Adam then momentum: max weight difference to unsharded " << switchDiff << '\n';
+		}
+		ok = ok and switchDiff < 1.0e-10;
+	}
+
+	//there is no ZeRO-3
+	NN::MPITrainerOptions bad = opts;
+	bad.zeroStage = 3;
+	bool rejected = false;
+	try{
+		NN::MPIDataParallelTrainer trainer(MPI_COMM_WORLD, bad);
+	} catch(const char*){
+		rejected = true;
+	}
+	ok = ok and rejected;
+
+	//each rank would average only its own shard
+	NN::MPITrainerOptions zopts = opts;
+	zopts.zeroStage = 1;
+	NN::Network averaged = base;
+	adam.averaging = NN::Averaging::EMA;
+	averaged.setOptimizer(NN::UpdateRule::Adam, adam);
+	rejected = false;
+	try{
+		NN::MPIDataParallelTrainer(MPI_COMM_WORLD, zopts).step(averaged, Xlocal, ylocal);
+	} catch(const char*){
+		rejected = true;
+	}
+	ok = ok and rejected;
+
+	int allOk = ok;
+	MPI_Allreduce(MPI_IN_PLACE, &allOk, 1, MPI_INT, MPI_LAND, MPI_COMM_WORLD);
+	if(rank == 0){
+		std::cout << (allOk ? "PASSED\n" : "FAILED\n");
+	}
+	MPI_Finalize();
+	return allOk ? 0 : 1;
+}
@@ -0,0 +1,309 @@
+#include "../include/Optimizer.hpp"
+#include "../include/Network.hpp"
+#include "../include/Layer.hpp"
+#include <Eigen/Core>
+#include <iostream>
+#include <vector>
+#include <cmath>
+
+using Mat = NN::Mat;
+using Vec = NN::Vec;
+using NN::UpdateRule;
+
+//unfused reference implementations, one Eigen statement per quantity
+void referenceStep(UpdateRule rule, const NN::OptimizerParams& p, Vec& w, const Vec& g,
+		   Vec& m, Vec& v, int t)
+{
+	const double lr = p.learningRate, mu = p.momentum;
+	Vec vOld = m;
+	switch(rule){
+	case UpdateRule::Momentum:
+		m = mu * m - lr * g;
+		w += m;
+		break;
+	case UpdateRule::NesterovAccGrad:
+		m = mu * m - lr * g;
+		w += (1.0 + mu) * m - mu * vOld;
+		break;
+	case UpdateRule::Adam:
+	case UpdateRule::AdamW: {
+		m = p.beta1 * m + (1.0 - p.beta1) * g;
+		v = p.beta2 * v + (1.0 - p.beta2) * g.cwiseProduct(g);
+		Vec mhat = m / (1.0 - std::pow(p.beta1, t));
+		Vec vhat = v / (1.0 - std::pow(p.beta2, t));
+		Vec wd = rule == UpdateRule::AdamW ? Vec(lr * p.weightDecay * w) : Vec(Vec::Zero(w.size()));
+		w -= (lr * mhat.array() / (vhat.array().sqrt() + p.epsilon)).matrix() + wd;
+		break;
+	}
+	case UpdateRule::RMSProp:
+		v = p.beta2 * v + (1.0 - p.beta2) * g.cwiseProduct(g);
+		m = mu * m + (g.array() / (v.array().sqrt() + p.epsilon)).matrix();
+		w -= lr * m;
+		break;
+	case UpdateRule::AdaGrad:
+		v += g.cwiseProduct(g);
+		w -= (lr * g.array() / (v.array().sqrt() + p.epsilon)).matrix();
+		break;
+	case UpdateRule::LARS: {
+		double local = p.trustCoefficient * w.norm() / (g.norm() + p.weightDecay * w.norm());
+		m = mu * m - lr * local * (g + p.weightDecay * w);
+		w += m;
+		break;
+	}
+	case UpdateRule::LAMB: {
+		m = p.beta1 * m + (1.0 - p.beta1) * g;
+		v = p.beta2 * v + (1.0 - p.beta2) * g.cwiseProduct(g);
+		Vec mhat = m / (1.0 - std::pow(p.beta1, t));
+		Vec vhat = v / (1.0 - std::pow(p.beta2, t));
+		Vec u = (mhat.array() / (vhat.array().sqrt() + p.epsilon)).matrix() + p.weightDecay * w;
+		w -= lr * (w.norm() / u.norm()) * u;
+		break;
+	}
+	}
+}
+
+int trainIterations(UpdateRule rule, const NN::OptimizerParams& params, const Mat& input, const Vec& targ)
+{
+	std::srand(3);
+	NN::Layer l1(std::make_pair(2, 10), 8, "sigmoid");
+	NN::Layer l2(std::make_pair(2, 8), 5, "sigmoid");
+	NN::Layer l3(std::make_pair(2, 5), 1, "sigmoid");
+	NN::Network net("sigmoid", "L2", {l1, l2, l3});
+	net.setInputs(input);
+	net.setTarget(targ, true);
+	net.setOptimizer(rule, params);
+	net.train(1.0e-5, 1000000, std::nullopt, std::nullopt, true);
+	return net.getLossHistory().size();
+}
+
+int main(){
+	bool ok = true;
+	const int n = 1003;
+
+	NN::OptimizerParams params;
+	params.learningRate = 0.01;
+	params.momentum = 0.9;
+	params.weightDecay = 0.1;
+
+	for(auto rule : {UpdateRule::Momentum, UpdateRule::NesterovAccGrad, UpdateRule::Adam,
+			 UpdateRule::AdamW, UpdateRule::RMSProp, UpdateRule::AdaGrad,
+			 UpdateRule::LARS, UpdateRule::LAMB}){
+		Vec w = Vec::Random(n), wRef = w, wEma = w, wSwa = w;
+		Vec m = Vec::Zero(n), v = Vec::Zero(n);
+		NN::OptimizerState state, stateEma, stateSwa;
+		//the averages folded into the kernels, against the EMA from the initial weights and
+		//the mean of the weights after updates 3, 5, 7 and 9
+		NN::OptimizerParams ema = params, swa = params;
+		ema.averaging = NN::Averaging::EMA;
+		ema.emaDecay = 0.9;
+		swa.averaging = NN::Averaging::SWA;
+		swa.swaStart = 3;
+		swa.swaPeriod = 2;
+		Vec emaRef = w, swaRef = Vec::Zero(n);
+		for(int t = 1; t <= 10; t++){
+			Vec g = Vec::Random(n);
+			NN::applyUpdate(rule, params, w.data(), g.data(), state, n);
+			NN::applyUpdate(rule, ema, wEma.data(), g.data(), stateEma, n);
+			NN::applyUpdate(rule, swa, wSwa.data(), g.data(), stateSwa, n);
+			referenceStep(rule, params, wRef, g, m, v, t);
+			emaRef = 0.9 * emaRef + 0.1 * wRef;
+			if(t % 2 == 1 and t >= 3){
+				swaRef += 0.25 * wRef;
+			}
+		}
+		double err = (w - wRef).cwiseAbs().maxCoeff();
+		double avgErr = std::max((Eigen::Map<const Vec>(stateEma.average.data(), n) - emaRef).cwiseAbs().maxCoeff(),
+					 (Eigen::Map<const Vec>(stateSwa.average.data(), n) - swaRef).cwiseAbs().maxCoeff());
+		std::cout << "rule " << static_cast<int>(rule) << ": max difference from reference " << err
+			  << ", of the EMA/SWA averages " << avgErr << '\n';
+		ok = ok and err < 1.0e-12 and avgErr < 1.0e-12 and wEma == w and wSwa == w
+			and stateSwa.numAveraged == 4;
+	}
+
+	//regularizers fused into the kernels against applying them after the step, on a
+	//(rows+1) x cols block whose last row, the bias, they leave alone
+	for(auto rule : {UpdateRule::Momentum, UpdateRule::Adam, UpdateRule::RMSProp, UpdateRule::LAMB}){
+		const int rows = 40, cols = 25, nReg = rows * cols, nAll = nReg + cols;
+		NN::OptimizerParams p = params;
+		p.l2 = 0.05;
+		p.decoupledDecay = 0.5;
+		p.l1 = 0.2;
+		p.maxNorm = 2.0;
+		const double mult = 0.99;
+		Vec w = Vec::Random(nAll), wRef = w;
+		Vec m = Vec::Zero(nAll), v = Vec::Zero(nAll);
+		NN::OptimizerState state;
+		for(int t = 1; t <= 10; t++){
+			Vec g = Vec::Random(nAll), gReg = g;
+			gReg.head(nReg) += p.l2 * wRef.head(nReg);
+			NN::applyUpdate(rule, p, w.data(), g.data(), state, nAll, nReg, cols, mult);
+			referenceStep(rule, params, wRef, gReg, m, v, t);
+			Eigen::Map<Mat> W(wRef.data(), rows, cols);
+			W *= mult * (1.0 - p.learningRate * p.decoupledDecay);
+			W = (W.array().abs() - p.learningRate * p.l1).max(0.0) * W.array().sign();
+			for(int j = 0; j < cols; j++){
+				if(W.col(j).norm() > p.maxNorm){
+					W.col(j) *= p.maxNorm / W.col(j).norm();
+				}
+			}
+		}
+		Eigen::Map<const Mat> W(w.data(), rows, cols);
+		double err = (w - wRef).cwiseAbs().maxCoeff();
+		double maxCol = W.colwise().norm().maxCoeff();
+		int zeros = (W.array() == 0.0).count();
+		std::cout << "rule " << static_cast<int>(rule) << " regularized: max difference from reference " << err
+			  << ", largest column norm " << maxCol << ", " << zeros << " weights at zero\n";
+		ok = ok and err < 1.0e-12 and maxCol <= p.maxNorm + 1.0e-12 and zeros > 0;
+	}
+
+	//the trust ratio makes LARS/LAMB steps independent of the gradient's scale, which is what
+	//lets the learning rate carry over between batch sizes
+	for(auto rule : {UpdateRule::LARS, UpdateRule::LAMB}){
+		NN::OptimizerParams p;
+		p.learningRate = 0.1;
+		p.momentum = 0.9;
+		p.trustCoefficient = 0.01;
+		Vec w1 = Vec::Random(n), w2 = w1;
+		NN::OptimizerState s1, s2;
+		for(int t = 1; t <= 5; t++){
+			Vec g = Vec::Random(n), gBig = 1000.0 * g;
+			NN::applyUpdate(rule, p, w1.data(), g.data(), s1, n);
+			NN::applyUpdate(rule, p, w2.data(), gBig.data(), s2, n);
+		}
+		double rel = (w1 - w2).norm() / w1.norm();
+		std::cout << "rule " << static_cast<int>(rule) << ": relative change from scaling the gradient by 1000: "
+			  << rel << '\n';
+		ok = ok and rel < 1.0e-6;
+	}
+
+	//a network swaps its averaged weights in for evaluation by exchanging buffers, and back
+	{
+		std::srand(5);
+		Mat X = Mat::Random(20, 4);
+		Vec y = X.rowwise().sum();
+		NN::Layer l1(std::make_pair(20, 4), 6, "tanh");
+		NN::Layer l2(std::make_pair(20, 6), 1, "linear");
+		NN::Network net("tanh", "L2", {l1, l2});
+		net.getLayersRef().back().setActivation("linear");
+		net.setInputs(X);
+		net.setTarget(y, true);
+		NN::OptimizerParams p;
+		p.learningRate = 1.0e-2;
+		p.averaging = NN::Averaging::EMA;
+		p.emaDecay = 0.95;
+		net.setOptimizer(UpdateRule::Adam, p);
+		for(int t = 0; t < 50; t++){
+			net.predict();
+			net.backwardPass();
+			net.updateWeights();
+		}
+		const Vec trained = net.getFlatWeights();
+		Vec averaged(trained.size());
+		std::vector<const double*> buffers;
+		int_fast64_t offset = 0;
+		for(const auto& l : net.getLayersRef()){
+			const Mat& a = l.getAveragedWeights();
+			averaged.segment(offset, a.size()) = Eigen::Map<const Vec>(a.data(), a.size());
+			offset += a.size();
+			buffers.push_back(a.data());
+		}
+		net.swapAveragedWeights();
+		bool noCopy = net.averagedWeightsSwapped();
+		size_t i = 0;
+		for(const auto& l : net.getLayersRef()){
+			noCopy = noCopy and l.getAveragedWeights().data() == buffers[i++];
+		}
+		const bool swappedIn = net.getFlatWeights() == averaged;
+		bool refused = false;
+		try{
+			net.updateWeights();
+		} catch(const char*){
+			refused = true;
+		}
+		net.swapAveragedWeights();
+		const bool restored = not net.averagedWeightsSwapped() and net.getFlatWeights() == trained;
+		std::cout << "averaged weights swapped in without copying: " << noCopy << ", match the averages: "
+			  << swappedIn << ", updates refused: " << refused << ", restored: " << restored << '\n';
+		ok = ok and noCopy and swappedIn and refused and restored and averaged != trained;
+
+		//a layer without averages: nothing is swapped
+		net.getLayersRef().back().setOptimizer(UpdateRule::Momentum, NN::OptimizerParams());
+		bool partial = false;
+		try{
+			net.swapAveragedWeights();
+		} catch(const char*){
+			partial = true;
+		}
+		partial = partial and not net.getLayersRef().front().averagedWeightsSwapped()
+			and net.getFlatWeights() == trained;
+		std::cout << "swap refused while a layer has no averages, nothing swapped: " << partial << '\n';
+		ok = ok and partial;
+	}
+
+	//the global gradient norm comes from the layers' backward passes; clipping by it inside
+	//the update matches scaling the gradients first, and train() stops on it
+	{
+		std::srand(7);
+		Mat X = Mat::Random(30, 5);
+		Vec y = X.rowwise().sum();
+		NN::Layer l1(std::make_pair(30, 5), 8, "tanh");
+		NN::Layer l2(std::make_pair(30, 8), 1, "linear");
+		NN::Network clipped("tanh", "L2", {l1, l2});
+		clipped.getLayersRef().back().setActivation("linear");
+		clipped.setInputs(X);
+		clipped.setTarget(y, true);
+		NN::OptimizerParams p;
+		p.learningRate = 1.0e-2;
+		p.momentum = 0.9;
+		clipped.setOptimizer(UpdateRule::Momentum, p);
+		NN::Network manual = clipped;
+		clipped.predict();
+		clipped.backwardPass();
+		const double norm = clipped.getGradientNorm();
+		const double normErr = std::abs(norm - clipped.getFlatGradient().norm()) / norm;
+		clipped.setGradientClipping(0.5 * norm);
+		clipped.updateWeights();
+		manual.predict();
+		manual.backwardPass();
+		for(auto& l : manual.getLayersRef()){
+			l.setGradient(0.5 * l.getGradient());
+		}
+		manual.updateWeights();
+		const double clipErr = (clipped.getFlatWeights() - manual.getFlatWeights()).cwiseAbs().maxCoeff();
+
+		const double tol = 1.0e-3;
+		NN::Network trained = manual;
+		trained.train(tol, 100000, std::nullopt, std::nullopt, true);
+		const double stopNorm = trained.getGradientNorm();
+		std::cout << "global gradient norm relative error " << normErr << ", clipped update difference "
+			  << clipErr << ", norm when train() stopped " << stopNorm << " after "
+			  << trained.getLossHistory().size() << " iterations\n";
+		ok = ok and normErr < 1.0e-12 and clipErr < 1.0e-14 and stopNorm <= tol
+			and trained.getLossHistory().size() < 100000;
+	}
+
+	//the networktest problem
+	Mat input = Mat::Random(2, 10);
+	Vec targ = 0.15 * Vec::Ones(2);
+
+	NN::OptimizerParams sgd;
+	sgd.learningRate = 1.0e-3;
+	sgd.momentum = 0.2;
+	NN::OptimizerParams adam;
+	adam.learningRate = 1.0e-2;
+	int itMomentum = trainIterations(UpdateRule::Momentum, sgd, input, targ);
+	int itAdam = trainIterations(UpdateRule::Adam, adam, input, targ);
+	NN::OptimizerParams lars = sgd;
+	lars.learningRate = 1.0;
+	lars.momentum = 0.9;
+	lars.trustCoefficient = 0.01;
+	NN::OptimizerParams lamb = adam;
+	int itLars = trainIterations(UpdateRule::LARS, lars, input, targ);
+	int itLamb = trainIterations(UpdateRule::LAMB, lamb, input, targ);
+	std::cout << "Iterations to converge: momentum " << itMomentum << ", Adam " << itAdam
+		  << ", LARS " << itLars << ", LAMB " << itLamb << '\n';
+	ok = ok and itLars < 1000000 and itLamb < 1000000;
+
+	std::cout << (ok ? "PASSED\n" : "FAILED\n");
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,76 @@
+#include "../include/RecursiveLeastSquares.hpp"
+#include "../include/Network.hpp"
+#include "../include/Layer.hpp"
+#include <Eigen/Core>
+#include <iostream>
+#include <cmath>
+
+using Mat = NN::Mat;
+using Vec = NN::Vec;
+
+int main(){
+	bool ok = true;
+
+	//a frozen random tanh trunk 3 -> 60 and a linear head 60 -> 1
+	const int N = 500;
+	Mat X = Mat::Random(N, 3);
+	Vec y(N);
+	for(int i = 0; i < N; i++){
+		y[i] = std::sin(2.0 * X(i, 0)) + X(i, 1) * X(i, 2);
+	}
+	NN::Layer trunk(std::make_pair(N, 3), 60, "tanh");
+	NN::Layer head(std::make_pair(N, 60), 1, "linear");
+	NN::Network net("tanh", "L2", {trunk, head});
+	net.getLayersRef().back().setActivation("linear");
+	net.setInputs(X);
+	net.setTarget(y, true);
+	net.predict();
+	const double lossBefore = net.getScalarLoss();
+
+	//one streaming pass in blocks of 64 rows against all rows at once
+	const double lambda = 1.0e-4;
+	net.solveOutputLayer(lambda, 64);
+	Mat Wstream = net.getLayersRef().back().getWeights();
+	net.solveOutputLayer(lambda);
+	Mat Wfull = net.getLayersRef().back().getWeights();
+	const double blockErr = (Wstream - Wfull).norm() / Wfull.norm();
+
+	//optimality: the loss gradient w.r.t. the head plus lambda W vanishes
+	net.backwardPass();
+	Mat G = net.getLayersRef().back().getGradient() + lambda * Wfull;
+	std::cout << "ridge head: loss " << lossBefore << " -> " << net.getScalarLoss()
+		  << ", streamed vs. single block " << blockErr
+		  << ", |gradient + lambda W| " << G.norm() << '\n';
+	ok = ok and blockErr < 1.0e-8 and G.norm() < 1.0e-8 and net.getScalarLoss() < 0.01 * lossBefore;
+
+	//recursive least squares over batches of 50 reaches the same weights
+	NN::RecursiveLeastSquares rls(lambda);
+	for(int start = 0; start < N; start += 50){
+		rls.update(net, X.middleRows(start, 50), y.segment(start, 50));
+	}
+	Mat Wrls = net.getLayersRef().back().getWeights();
+	const double rlsErr = (Wrls - Wfull).norm() / Wfull.norm();
+	std::cout << "RLS over " << rls.getNumSamples() << " rows in batches of 50: relative difference "
+		  << rlsErr << '\n';
+	ok = ok and rlsErr < 1.0e-6;
+
+	//a sigmoid head is fit through the inverse activation: exact for a sigmoid of the features
+	NN::Layer strunk(std::make_pair(N, 3), 20, "tanh");
+	NN::Layer shead(std::make_pair(N, 20), 1, "sigmoid");
+	NN::Network snet("tanh", "L2", {strunk, shead});
+	snet.getLayersRef().back().setActivation("sigmoid");
+	Mat H = snet.outputLayerFeatures(X);
+	Vec wTrue = Vec::Random(21);
+	Vec ys = (H * wTrue).unaryExpr([](double a){ return 1.0 / (1.0 + std::exp(-a)); });
+	snet.setInputs(X);
+	snet.setTarget(ys, true);
+	snet.solveOutputLayer(1.0e-12);
+	Vec wFit = Eigen::Map<const Vec>(snet.getLayersRef().back().getWeights().data(), 21);
+	const double sErr = (wFit - wTrue).norm() / wTrue.norm();
+	std::cout << "sigmoid head: recovered weights relative error " << sErr
+		  << ", loss " << snet.getScalarLoss() << '\n';
+	ok = ok and sErr < 1.0e-5;
+
+	std::cout << (ok ? "PASSED\n" : "FAILED\n");
+	return ok ? 0 : 1;
+}
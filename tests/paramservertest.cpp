@@ -0,0 +1,139 @@
+#include "../include/ParameterServer.hpp"
+#include "../include/Network.hpp"
+#include "../include/Layer.hpp"
+#include <Eigen/Core>
+#include <iostream>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using Mat = NN::Mat;
+using Vec = NN::Vec;
+
+const int W = 3, batch = 25, epochs = 20;
+
+//worker W - 1 sleeps before every push; the others train flat out
+void worker(int id, const NN::Network& base, const Mat& X, const Vec& y, const std::string& path){
+	const int n = X.rows() / W;
+	NN::Network net = base;
+	NN::ParameterClient client(path, id);
+	if(id < W - 1){
+		client.train(net, X.middleRows(id * n, n), y.segment(id * n, n), batch, epochs, id);
+		return;
+	}
+	for(int e = 0; e < epochs; e++){
+		for(int start = 0; start < n; start += batch){
+			client.pull(net);
+			net.setBatch(X.middleRows(id * n + start, batch), y.segment(id * n + start, batch));
+			net.predict();
+			net.backwardPass();
+			std::this_thread::sleep_for(std::chrono::milliseconds(2));
+			client.push(net);
+		}
+	}
+	client.done();
+}
+
+int main(){
+	bool ok = true;
+
+	const int N = 600;
+	Mat X = Mat::Random(N, 4);
+	Vec y = X.rowwise().sum().array().sin();
+	NN::Layer l1(std::make_pair(N, 4), 16, "tanh");
+	NN::Layer l2(std::make_pair(N, 16), 1, "linear");
+	NN::Network base("tanh", "L2", {l1, l2});
+	base.getLayersRef().back().setActivation("linear");
+	base.setInputs(X);
+	base.setTarget(y, true);
+	NN::OptimizerParams sgd;
+	sgd.learningRate = 2.0e-3;
+	sgd.momentum = 0.5;
+	base.setOptimizer(NN::UpdateRule::Momentum, sgd);
+	base.predict();
+	const double initialLoss = base.getScalarLoss() / N;
+
+	for(int staleness : {2, 1000}){
+		NN::ParameterServerOptions opts;
+		opts.socketPath = "/tmp/nn_pstest_" + std::to_string(getpid()) + ".sock";
+		opts.numWorkers = W;
+		opts.staleness = staleness;
+		NN::ParameterServer server(base, opts);
+		std::vector<pid_t> children;
+		for(int id = 0; id < W; id++){
+			const pid_t pid = fork();
+			if(pid == 0){
+				try {
+					worker(id, base, X, y, opts.socketPath);
+				} catch(const char* e) {
+					std::cerr << e << '\n';
+					_exit(1);
+				}
+				_exit(0);
+			}
+			children.push_back(pid);
+		}
+		server.serve();
+		bool workersOk = true;
+		for(pid_t pid : children){
+			int status;
+			waitpid(pid, &status, 0);
+			workersOk = workersOk and WIFEXITED(status) and WEXITSTATUS(status) == 0;
+		}
+
+		NN::Network trained = server.getNetwork();
+		trained.setBatch(X, y);
+		trained.predict();
+		const double finalLoss = trained.getScalarLoss() / N;
+		const int_fast64_t pushes = W * epochs * (N / W / batch);
+		std::cout << "staleness " << staleness << ": loss " << initialLoss << " -> " << finalLoss
+			  << ", " << server.getVersion() << " updates, " << server.getNumDelayedPulls()
+			  << " pulls held back, largest clock gap served " << server.getMaxServedGap() << '\n';
+		ok = ok and workersOk and server.getVersion() == pushes and finalLoss < 0.1 * initialLoss
+			and server.getMaxServedGap() <= staleness;
+		//bounded: the fast workers had to wait; unbounded: they ran ahead of the slow one
+		ok = ok and (staleness == 2 ? server.getNumDelayedPulls() > 0 : server.getMaxServedGap() > 2);
+	}
+
+	//a connection that hangs up before Hello can't be counted as any worker's Done, and a
+	//message of unknown type is not taken for one
+	for(std::uint32_t type : {0u, 99u}){
+		NN::ParameterServerOptions opts;
+		opts.socketPath = "/tmp/nn_pstest_" + std::to_string(getpid()) + ".sock";
+		opts.numWorkers = 1;
+		NN::ParameterServer server(base, opts);
+		const pid_t pid = fork();
+		if(pid == 0){
+			sockaddr_un addr{};
+			addr.sun_family = AF_UNIX;
+			opts.socketPath.copy(addr.sun_path, sizeof(addr.sun_path) - 1);
+			const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+			connect(fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr));
+			if(type != 0){
+				//the wire header: type, worker, count
+				struct { std::uint32_t type, worker; std::int64_t count; } h{type, 0, 0};
+				send(fd, &h, sizeof(h), 0);
+			}
+			close(fd);
+			_exit(0);
+		}
+		bool threw = false;
+		try {
+			server.serve();
+		} catch(const char*) {
+			threw = true;
+		}
+		waitpid(pid, nullptr, 0);
+		std::cout << (type == 0 ? "hang-up before hello " : "message of unknown type ")
+			  << (threw ? "rejected" : "accepted") << '\n';
+		ok = ok and threw;
+	}
+
+	std::cout << (ok ? "PASSED\n" : "FAILED\n");
+	return ok ? 0 : 1;
+}
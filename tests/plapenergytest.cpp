@@ -0,0 +1,82 @@
+#include "../include/PlapEnergy.hpp"
+#include "../include/Network.hpp"
+#include <Eigen/Core>
+#include <iostream>
+#include <cmath>
+
+using Mat = NN::Mat;
+using Vec = NN::Vec;
+
+int main(){
+	bool ok = true;
+	const double p = 3.0, h = 1.0e-6;
+
+	Vec lower = Vec::Zero(2), upper = Vec::Ones(2);
+	auto grid = NN::CollocationGrid::structured(lower, upper, {9, 7});
+	std::cout << "Grid has " << grid.points.rows() << " points, weight sum " << grid.weights.sum() << '\n';
+	ok = ok and std::abs(grid.weights.sum() - 1.0) < 1.0e-12;
+
+	Vec f(grid.points.rows());
+	for(int i = 0; i < f.size(); i++){
+		f[i] = std::sin(M_PI * grid.points(i,0)) * std::cos(M_PI * grid.points(i,1));
+	}
+
+	NN::Layer l1(std::make_pair(2, 2), 8, "tanh");
+	NN::Layer l2(std::make_pair(2, 8), 8, "softplus");
+	NN::Layer l3(std::make_pair(2, 8), 1, "linear");
+	NN::Network net({l1, l2, l3});
+
+	NN::PlapEnergyLoss loss(p, grid, f);
+	double E = loss.evaluateWithGradient(net);
+	Mat gradU = loss.getGradU();
+	Vec u = loss.getU();
+
+	//grad u from the tangent pass vs. shifted grids
+	double guErr = 0.0;
+	for(int k = 0; k < 2; k++){
+		auto gp = grid, gm = grid;
+		gp.points.col(k).array() += h;
+		gm.points.col(k).array() -= h;
+		NN::PlapEnergyLoss lp(p, gp, f), lm(p, gm, f);
+		lp.evaluate(net);
+		lm.evaluate(net);
+		guErr = std::max(guErr, ((lp.getU() - lm.getU()) / (2*h) - gradU.col(k)).cwiseAbs().maxCoeff());
+	}
+	std::cout << "grad u max error vs. finite differences: " << guErr << '\n';
+	ok = ok and guErr < 1.0e-6;
+
+	//dE/dW vs. finite differences of the energy
+	auto weights = net.getWeights();
+	std::list<Mat> grads;
+	for(const auto& l : net.getLayers()){
+		grads.push_back(l.getGradient());
+	}
+	double gErr = 0.0;
+	auto git = grads.begin();
+	for(size_t li = 0; li < weights.size(); li++, git++){
+		for(int k = 0; k < 3; k++){
+			auto wp = weights, wm = weights;
+			auto itp = std::next(wp.begin(), li), itm = std::next(wm.begin(), li);
+			int r = k % itp->rows(), c = (2*k) % itp->cols();
+			(*itp)(r,c) += h;
+			(*itm)(r,c) -= h;
+			net.setWeights(wp);
+			double Ep = loss.evaluate(net);
+			net.setWeights(wm);
+			double Em = loss.evaluate(net);
+			gErr = std::max(gErr, std::abs((Ep - Em) / (2*h) - (*git)(r,c)));
+		}
+	}
+	net.setWeights(weights);
+	std::cout << "dE/dW max error vs. finite differences: " << gErr << '\n';
+	ok = ok and gErr < 1.0e-6;
+
+	net.setUpdateParams(0.05, 0.9);
+	loss.train(net, 1.0e-8, 2000);
+	auto hist = loss.getEnergyHistory();
+	std::cout << "Energy: " << E << " -> " << hist.back() << " in " << hist.size() << " iterations\n";
+	ok = ok and hist.back() < E;
+
+	std::cout << (ok ? "PASSED\n" : "FAILED\n");
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,63 @@
+#include "../include/PlapNetwork.hpp"
+#include "../include/Layer.hpp"
+#include <Eigen/Core>
+#include <iostream>
+#include <cmath>
+
+using Mat = NN::Mat;
+using Vec = NN::Vec;
+
+int main(){
+	bool ok = true;
+
+	//analytic Jacobian of a |z|^(p-2) vs. central differences
+	Mat Z = Mat::Random(6, 3);
+	const double h = 1.0e-6;
+	for(double p : {1.5, 2.0, 3.0, 4.0, 5.5}){
+		NN::PlapFinalLayer plap(std::make_pair(6, 3), p, 0.7);
+		plap.forwardPass(Z);
+		Vec out = plap.getOutput();
+		Mat J = plap.computeJacobian();
+
+		double err = 0.0;
+		for(int i = 0; i < Z.rows(); i++){
+			for(int j = 0; j < Z.cols(); j++){
+				Mat zp = Z, zm = Z;
+				zp(i,j) += h;
+				zm(i,j) -= h;
+				plap.forwardPass(zp);
+				double fp = plap.getOutput()[i];
+				plap.forwardPass(zm);
+				double fm = plap.getOutput()[i];
+				err = std::max(err, std::abs((fp - fm) / (2*h) - J(i,j)));
+			}
+		}
+		double ref = 0.7 * std::pow(Z.row(0).norm(), p - 2.0);
+		std::cout << "p = " << p << ": output error " << std::abs(out[0] - ref)
+			  << ", Jacobian error " << err << '\n';
+		ok = ok and err < 1.0e-6 and std::abs(out[0] - ref) < 1.0e-12;
+	}
+
+	//dense layers produce a 3-vector per sample, the final layer maps it to a |z|
+	NN::Layer l1(std::make_pair(8, 2), 6, "tanh");
+	NN::Layer l2(std::make_pair(8, 6), 3, "tanh");
+	NN::PlapNetwork net("tanh", "L2", {l1, l2}, 3.0, 1.0);
+
+	Mat X = Mat::Random(8, 2);
+	Vec targ = 0.5 + 0.3 * X.col(0).array();
+	net.setInputs(X);
+	net.setTarget(targ);
+	net.setUpdateParams(0.05, 0.5);
+
+	net.predict();
+	double initialLoss = net.getScalarLoss();
+	net.train(1.0e-6, 5000, std::nullopt, std::nullopt, true);
+	double finalLoss = net.getScalarLoss();
+
+	std::cout << "PlapNetwork loss: " << initialLoss << " -> " << finalLoss
+		  << " in " << net.getLossHistory().size() << " iterations\n";
+	ok = ok and finalLoss < 0.1 * initialLoss;
+
+	std::cout << (ok ? "PASSED\n" : "FAILED\n");
+	return ok ? 0 : 1;
+}
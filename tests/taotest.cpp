@@ -0,0 +1,39 @@
+#include "../include/TaoTrainer.hpp"
+#include "../include/Network.hpp"
+#include "../include/Layer.hpp"
+#include <Eigen/Core>
+#include <iostream>
+
+using Mat = NN::Mat;
+using Vec = NN::Vec;
+
+int main(){
+	bool ok = true;
+	std::cout << "PETSc " << (NN::TaoTrainer::havePetsc() ? "available" : "not available") << '\n';
+
+	for(std::string type : {"blmvm", "lmvm", "bncg", "nls"}){
+		NN::Layer l1(std::make_pair(2, 10), 8, "sigmoid");
+		NN::Layer l2(std::make_pair(2, 8), 5, "sigmoid");
+		NN::Layer l3(std::make_pair(2, 5), 1, "sigmoid");
+		NN::Network net("sigmoid", "L2", {l1, l2, l3});
+
+		Mat input = Mat::Random(2, 10);
+		Vec targ = 0.15 * Vec::Ones(2);
+		net.setInputs(input);
+		net.setTarget(targ, true);
+
+		NN::TaoOptions opts;
+		opts.type = type;
+		opts.gatol = 1.0e-6;
+		opts.maxIter = 2000;
+		NN::TaoTrainer tao(opts);
+		bool converged = tao.train(net, std::nullopt, std::nullopt, true);
+
+		std::cout << type << ": " << tao.getConvergedReason() << " after "
+			  << tao.getLossHistory().size() << " iterations, loss " << net.getScalarLoss() << '\n';
+		ok = ok and converged;
+	}
+
+	std::cout << (ok ? "PASSED\n" : "FAILED\n");
+	return ok ? 0 : 1;
+}